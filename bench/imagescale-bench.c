@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Benchmark for the background scaler. A synthetic 4K and 8K image is scaled
+ * to common output sizes and converted to ARGB8888, once with imagescale and
+ * once with a naive scalar loop that evaluates the same tent filter per output
+ * pixel and swaps the channels while storing. It prints the time of both and
+ * the largest difference between their pixels, which is rounding only.
+ * Images with extreme aspect ratios are then rendered in every mode, where the
+ * cropped or fitted area must not round to nothing; it exits with 1 if any of
+ * them fails.
+ * Usage: make bench, or bench/imagescale-bench [repetitions]
+ */
+
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "imagescale.h"
+
+static double now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Gradients plus noise, so neither the filter nor the caches get an easy ride */
+static struct imagescale_image make_image(int width, int height) {
+	struct imagescale_image image = {
+		.width = width,
+		.height = height,
+		.stride = width * 4,
+	};
+	image.pixels = malloc((size_t)image.stride * height);
+	uint32_t seed = 12345;
+	for (int y = 0; image.pixels && y < height; y++) {
+		unsigned char *row = image.pixels + (size_t)y * image.stride;
+		for (int x = 0; x < width; x++) {
+			seed = seed * 1664525u + 1013904223u;
+			row[x * 4] = (unsigned char)(x * 255 / width);
+			row[x * 4 + 1] = (unsigned char)(y * 255 / height);
+			row[x * 4 + 2] = (unsigned char)(seed >> 24);
+			row[x * 4 + 3] = 255;
+		}
+	}
+	return image;
+}
+
+/* Straightforward version: the 2D filter for every output pixel, RGBA to BGRA */
+static void naive_scale(const struct imagescale_image *src, const struct imagescale_image *dst) {
+	double scale_x = (double)dst->width / src->width;
+	double scale_y = (double)dst->height / src->height;
+	double support_x = scale_x < 1.0 ? 1.0 / scale_x : 1.0;
+	double support_y = scale_y < 1.0 ? 1.0 / scale_y : 1.0;
+	for (int y = 0; y < dst->height; y++) {
+		double center_y = (y + 0.5) / scale_y;
+		int y0 = (int)fmax(0, floor(center_y - support_y));
+		int y1 = (int)fmin(src->height, ceil(center_y + support_y));
+		for (int x = 0; x < dst->width; x++) {
+			double center_x = (x + 0.5) / scale_x;
+			int x0 = (int)fmax(0, floor(center_x - support_x));
+			int x1 = (int)fmin(src->width, ceil(center_x + support_x));
+			double acc[4] = {0}, sum = 0.0;
+			for (int j = y0; j < y1; j++) {
+				double weight_y = 1.0 - fabs((j + 0.5 - center_y) / support_y);
+				if (weight_y <= 0.0) {
+					continue;
+				}
+				const unsigned char *row = src->pixels + (size_t)j * src->stride;
+				for (int i = x0; i < x1; i++) {
+					double weight = 1.0 - fabs((i + 0.5 - center_x) / support_x);
+					if (weight <= 0.0) {
+						continue;
+					}
+					weight *= weight_y;
+					for (int c = 0; c < 4; c++) {
+						acc[c] += weight * row[i * 4 + c];
+					}
+					sum += weight;
+				}
+			}
+			unsigned char *pixel = dst->pixels + (size_t)y * dst->stride + (size_t)x * 4;
+			static const int bgra[4] = {2, 1, 0, 3};
+			for (int c = 0; c < 4; c++) {
+				double value = sum > 0.0 ? acc[bgra[c]] / sum : 0.0;
+				pixel[c] = (unsigned char)fmin(255.0, fmax(0.0, lround(value)));
+			}
+		}
+	}
+}
+
+int main(int argc, char *argv[]) {
+	int repetitions = argc > 1 ? atoi(argv[1]) : 3;
+	if (repetitions < 1) {
+		repetitions = 1;
+	}
+	static const struct {
+		const char *name;
+		int src_width, src_height;
+		int dst_width, dst_height;
+	} cases[] = {
+		{ "4K -> 1920x1080", 3840, 2160, 1920, 1080 },
+		{ "4K -> 2560x1440", 3840, 2160, 2560, 1440 },
+		{ "8K -> 1920x1080", 7680, 4320, 1920, 1080 },
+		{ "8K -> 3840x2160", 7680, 4320, 3840, 2160 },
+	};
+	printf("imagescale kernels: %s\n", imagescale_kernel());
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		struct imagescale_image src = make_image(cases[i].src_width, cases[i].src_height);
+		struct imagescale_image dst = {
+			.width = cases[i].dst_width,
+			.height = cases[i].dst_height,
+			.stride = cases[i].dst_width * 4,
+		};
+		struct imagescale_image naive = dst;
+		dst.pixels = malloc((size_t)dst.stride * dst.height);
+		naive.pixels = malloc((size_t)naive.stride * naive.height);
+		if (!src.pixels || !dst.pixels || !naive.pixels) {
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+
+		// Best of a few runs, the first one also pays for page faults
+		double best = INFINITY;
+		for (int r = 0; r < repetitions; r++) {
+			double start = now_ms();
+			if (!imagescale_resize(&src, &dst, IMAGESCALE_BGRA)) {
+				fprintf(stderr, "%s: imagescale failed\n", cases[i].name);
+				return 1;
+			}
+			best = fmin(best, now_ms() - start);
+		}
+		double start = now_ms();
+		naive_scale(&src, &naive);
+		double naive_ms = now_ms() - start;
+
+		int max_diff = 0;
+		for (size_t p = 0; p < (size_t)dst.stride * dst.height; p++) {
+			int diff = abs(dst.pixels[p] - naive.pixels[p]);
+			max_diff = diff > max_diff ? diff : max_diff;
+		}
+		printf("%s: imagescale %.1f ms, naive loop %.1f ms (%.1fx), max difference %d\n",
+						cases[i].name, best, naive_ms, naive_ms / best, max_diff);
+		free(naive.pixels);
+		free(dst.pixels);
+		free(src.pixels);
+	}
+
+	static const struct {
+		int src_width, src_height;
+		int dst_width, dst_height;
+	} extremes[] = {
+		{ 1, 1, 3440, 1440 },
+		{ 5, 400, 999, 3 },
+		{ 400, 5, 3, 999 },
+		{ 7680, 1, 1, 1080 },
+	};
+	static const enum imagescale_mode modes[] = {
+		IMAGESCALE_FILL, IMAGESCALE_FIT, IMAGESCALE_TILE, IMAGESCALE_STRETCH,
+	};
+	static const unsigned char fill[4] = {0, 0, 0, 255};
+	int failures = 0;
+	for (size_t i = 0; i < sizeof(extremes) / sizeof(extremes[0]); i++) {
+		struct imagescale_image src = make_image(extremes[i].src_width, extremes[i].src_height);
+		if (!src.pixels) {
+			fprintf(stderr, "Out of memory\n");
+			return 1;
+		}
+		for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+			struct imagescale_image out;
+			if (!imagescale_render(&src, extremes[i].dst_width, extremes[i].dst_height,
+										modes[m], IMAGESCALE_BGRA, fill, &out)) {
+				printf("%dx%d -> %dx%d, mode %zu: failed\n", extremes[i].src_width,
+							extremes[i].src_height, extremes[i].dst_width,
+							extremes[i].dst_height, m);
+				failures++;
+				continue;
+			}
+			free(out.pixels);
+		}
+		free(src.pixels);
+	}
+	printf("extreme aspect ratios: %d of %zu renders failed\n", failures,
+						sizeof(extremes) / sizeof(extremes[0]) * sizeof(modes) / sizeof(modes[0]));
+	return failures ? 1 : 0;
+}
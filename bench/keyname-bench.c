@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Microbenchmark for xkb_keyname(), the keysym to name resolver used on every
+ * key event. It replays a typing-like stream of keysyms and prints the average
+ * cost per keystroke. If xkbcommon-keysyms.h is installed it also times the
+ * former implementation that grepped the header for every key, for comparison.
+ * Usage: make bench
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "getxkbkeyname.h"
+
+#define KEYSYMS_HEADER "/usr/include/xkbcommon/xkbcommon-keysyms.h"
+
+static const xkb_keysym_t typing[] = {
+	XKB_KEY_h, XKB_KEY_e, XKB_KEY_l, XKB_KEY_l, XKB_KEY_o, XKB_KEY_space, XKB_KEY_Shift_L,
+	XKB_KEY_W, XKB_KEY_o, XKB_KEY_r, XKB_KEY_l, XKB_KEY_d, XKB_KEY_comma, XKB_KEY_BackSpace,
+	XKB_KEY_Return, XKB_KEY_Control_L, XKB_KEY_c, XKB_KEY_Alt_L, XKB_KEY_Tab, XKB_KEY_Super_L,
+	XKB_KEY_x, XKB_KEY_1, XKB_KEY_exclam, XKB_KEY_Cyrillic_a, XKB_KEY_XF86AudioPlay,
+	XKB_KEY_Left, XKB_KEY_Right, XKB_KEY_Escape, XKB_KEY_F5, XKB_KEY_period,
+};
+
+static double now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* The header scan woodland used before, kept here only as a baseline */
+static char *legacy_xkb_keyname(const char *hexadecimal) {
+	FILE *file = fopen(KEYSYMS_HEADER, "r");
+	if (!file) {
+		return NULL;
+	}
+	char buffer[256];
+	char *keyname = NULL;
+	while (fgets(buffer, sizeof(buffer), file) != NULL) {
+		if (strstr(buffer, hexadecimal) != NULL) {
+			char *define_ptr = strstr(buffer, "#define");
+			if (define_ptr) {
+				char *start = define_ptr + strlen("#define");
+				while (*start == ' ' || *start == '\t') start++;
+				char *end = start;
+				while (*end && *end != ' ' && *end != '\t' && *end != '\n') end++;
+				keyname = strndup(start, end - start);
+				break;
+			}
+		}
+	}
+	fclose(file);
+	return keyname;
+}
+
+int main(int argc, char *argv[]) {
+	long iterations = argc > 1 ? atol(argv[1]) : 10000000;
+	size_t num_typing = sizeof(typing) / sizeof(typing[0]);
+	size_t checksum = 0;
+
+	// Cold: first lookup of every key, fills the cache
+	double start = now_ns();
+	for (size_t i = 0; i < num_typing; i++) {
+		const char *name = xkb_keyname(typing[i]);
+		checksum += name ? strlen(name) : 0;
+	}
+	double cold = (now_ns() - start) / num_typing;
+
+	start = now_ns();
+	for (long i = 0; i < iterations; i++) {
+		const char *name = xkb_keyname(typing[i % num_typing]);
+		checksum += name ? (size_t)name[8] : 0;
+	}
+	double warm = (now_ns() - start) / iterations;
+
+	printf("xkb_keyname: %.1f ns/keystroke cold, %.1f ns/keystroke warm (%ld keystrokes)\n",
+																cold, warm, iterations);
+
+	FILE *header = fopen(KEYSYMS_HEADER, "r");
+	if (header) {
+		fclose(header);
+		long legacy_iterations = 2000;
+		start = now_ns();
+		for (long i = 0; i < legacy_iterations; i++) {
+			char hexCode[256];
+			snprintf(hexCode, sizeof(hexCode), "%#06x", typing[i % num_typing]);
+			char *name = legacy_xkb_keyname(hexCode);
+			checksum += name ? strlen(name) : 0;
+			free(name);
+		}
+		double legacy = (now_ns() - start) / legacy_iterations;
+		printf("legacy header scan: %.1f ns/keystroke (%.0fx slower)\n", legacy, legacy / warm);
+	}
+	else {
+		printf("legacy header scan: skipped, %s not installed\n", KEYSYMS_HEADER);
+	}
+	return checksum == 0;
+}
@@ -0,0 +1,946 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* End to end benchmark of the compositor, it needs no GPU and no display.
+ * woodland is started on the wlroots headless backend with the pixman renderer
+ * in a private XDG_RUNTIME_DIR and HOME. N synthetic xdg-shell clients commit
+ * SHM buffers at a fixed rate while a virtual keyboard and a virtual pointer
+ * type and move over the focused window. Every client answers an input event
+ * with a commit, like a real application redrawing.
+ * Reported: input to client event and input to frame done latency, commit to
+ * frame done latency, woodland's CPU time and RSS, and the timing histograms
+ * woodland logs for output_frame, process_cursor_motion and keyboard_handle_key
+ * when it shuts down.
+ * Usage: make bench, or
+ *	bench/woodland-bench [-c clients] [-r commit Hz] [-k key Hz] [-m motion Hz]
+ *		[-d seconds] [-s WxH] [-t cpu threads] [-w path to woodland]
+ */
+
+#define _GNU_SOURCE
+#include <time.h>
+#include <poll.h>
+#include <math.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <linux/input-event-codes.h>
+#include <wayland-client.h>
+#include <xkbcommon/xkbcommon.h>
+#include "histogram.h"
+#include "xdg-shell-client-protocol.h"
+#include "virtual-keyboard-unstable-v1-client-protocol.h"
+#include "wlr-virtual-pointer-unstable-v1-client-protocol.h"
+
+#define MAX_CLIENTS 64
+#define OUTPUT_WIDTH 1280 // Default size of a wlroots headless output
+#define OUTPUT_HEIGHT 720
+#define STARTUP_TIMEOUT_MS 10000
+
+struct bench_buffer {
+	struct wl_buffer *buffer;
+	uint32_t *pixels;
+	bool busy;
+};
+
+struct bench_client {
+	int index;
+	int x, y; // Placement requested through window_place
+	struct wl_display *display;
+	struct wl_registry *registry;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct wl_seat *seat;
+	struct xdg_wm_base *wm_base;
+	struct wl_keyboard *keyboard;
+	struct wl_pointer *pointer;
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *toplevel;
+	struct bench_buffer buffers[2];
+	int width, height;
+	bool configured;
+	uint32_t frame_count;
+};
+
+/* Data of a frame callback, tells what the frame answered */
+struct bench_frame {
+	struct bench_client *client;
+	uint64_t commit_ns;
+	uint64_t key_ns; // Key press it answers, 0 if none
+	uint64_t motion_ns; // Pointer motion it answers, 0 if none
+};
+
+struct bench {
+	int num_clients;
+	int commit_rate, key_rate, motion_rate;
+	int duration;
+	int width, height;
+	int cpu_threads;
+	const char *woodland;
+	char tmpdir[64];
+	pid_t pid;
+
+	struct bench_client clients[MAX_CLIENTS];
+	struct bench_client control; // Owns the virtual keyboard and pointer
+	struct zwp_virtual_keyboard_manager_v1 *keyboard_mgr;
+	struct zwlr_virtual_pointer_manager_v1 *pointer_mgr;
+	struct zwp_virtual_keyboard_v1 *virtual_keyboard;
+	struct zwlr_virtual_pointer_v1 *virtual_pointer;
+	struct bench_client *focused;
+
+	uint64_t key_sent_ns, motion_sent_ns; // Pending input, 0 once it arrived
+	uint64_t keys_sent, keys_received, motions_sent, motions_received;
+	uint64_t commits, commits_skipped;
+	struct histogram key_event, key_frame, motion_event, motion_frame, commit_frame;
+};
+
+static struct bench bench = {
+	.num_clients = 4,
+	.commit_rate = 60,
+	.key_rate = 20,
+	.motion_rate = 120,
+	.duration = 10,
+	.width = 400,
+	.height = 300,
+	.cpu_threads = 0,
+	.woodland = "./woodland",
+};
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t now_ms(void) {
+	return (uint32_t)(now_ns() / 1000000);
+}
+
+/* Shared memory file of 'size' bytes, -1 on failure */
+static int create_shm_file(size_t size) {
+	int fd = memfd_create("woodland-bench", MFD_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* Buffers */
+
+static void buffer_release(void *data, struct wl_buffer *wl_buffer) {
+	(void)wl_buffer;
+	struct bench_buffer *buffer = data;
+	buffer->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	.release = buffer_release,
+};
+
+static bool client_create_buffers(struct bench_client *client) {
+	int stride = client->width * 4;
+	size_t size = (size_t)stride * client->height;
+	int fd = create_shm_file(size * 2);
+	if (fd < 0) {
+		return false;
+	}
+	uint32_t *pixels = mmap(NULL, size * 2, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (pixels == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+	struct wl_shm_pool *pool = wl_shm_create_pool(client->shm, fd, size * 2);
+	for (int i = 0; i < 2; i++) {
+		struct bench_buffer *buffer = &client->buffers[i];
+		buffer->pixels = pixels + (size / 4) * i;
+		buffer->buffer = wl_shm_pool_create_buffer(pool, size * i, client->width,
+											client->height, stride, WL_SHM_FORMAT_XRGB8888);
+		wl_buffer_add_listener(buffer->buffer, &buffer_listener, buffer);
+		uint32_t color = 0xff202020 + 0x00101010 * (client->index % 8);
+		for (size_t p = 0; p < size / 4; p++) {
+			buffer->pixels[p] = color;
+		}
+	}
+	wl_shm_pool_destroy(pool);
+	close(fd);
+	return true;
+}
+
+/* Frames */
+
+static void frame_done(void *data, struct wl_callback *callback, uint32_t time) {
+	(void)time;
+	struct bench_frame *frame = data;
+	uint64_t now = now_ns();
+	histogram_add(&bench.commit_frame, now - frame->commit_ns);
+	if (frame->key_ns) {
+		histogram_add(&bench.key_frame, now - frame->key_ns);
+	}
+	if (frame->motion_ns) {
+		histogram_add(&bench.motion_frame, now - frame->motion_ns);
+	}
+	wl_callback_destroy(callback);
+	free(frame);
+}
+
+static const struct wl_callback_listener frame_listener = {
+	.done = frame_done,
+};
+
+/* Draws a moving band into a free buffer and commits it with full damage.
+ * 'key_ns' and 'motion_ns' tag the frame as the answer to that input.
+ */
+static void client_commit(struct bench_client *client, uint64_t key_ns, uint64_t motion_ns) {
+	if (!client->configured) {
+		return;
+	}
+	struct bench_buffer *buffer = NULL;
+	for (int i = 0; i < 2; i++) {
+		if (!client->buffers[i].busy) {
+			buffer = &client->buffers[i];
+			break;
+		}
+	}
+	if (!buffer) {
+		bench.commits_skipped++;
+		return;
+	}
+	int band = 16;
+	int row = (client->frame_count * 4) % (client->height - band);
+	uint32_t color = 0xff000000 | (client->frame_count * 0x010305);
+	for (int y = row; y < row + band; y++) {
+		uint32_t *line = buffer->pixels + (size_t)y * client->width;
+		for (int x = 0; x < client->width; x++) {
+			line[x] = color;
+		}
+	}
+	client->frame_count++;
+
+	struct bench_frame *frame = calloc(1, sizeof(struct bench_frame));
+	if (frame) {
+		frame->client = client;
+		frame->key_ns = key_ns;
+		frame->motion_ns = motion_ns;
+		struct wl_callback *callback = wl_surface_frame(client->surface);
+		wl_callback_add_listener(callback, &frame_listener, frame);
+	}
+	wl_surface_attach(client->surface, buffer->buffer, 0, 0);
+	wl_surface_damage_buffer(client->surface, 0, 0, client->width, client->height);
+	buffer->busy = true;
+	if (frame) {
+		frame->commit_ns = now_ns();
+	}
+	wl_surface_commit(client->surface);
+	wl_display_flush(client->display);
+	bench.commits++;
+}
+
+/* Keyboard */
+
+static void keyboard_keymap(void *data, struct wl_keyboard *keyboard, uint32_t format,
+							int32_t fd, uint32_t size) {
+	(void)data; (void)keyboard; (void)format; (void)size;
+	close(fd);
+}
+
+static void keyboard_enter(void *data, struct wl_keyboard *keyboard, uint32_t serial,
+						struct wl_surface *surface, struct wl_array *keys) {
+	(void)keyboard; (void)serial; (void)surface; (void)keys;
+	bench.focused = data;
+}
+
+static void keyboard_leave(void *data, struct wl_keyboard *keyboard, uint32_t serial,
+						struct wl_surface *surface) {
+	(void)keyboard; (void)serial; (void)surface;
+	if (bench.focused == data) {
+		bench.focused = NULL;
+	}
+}
+
+static void keyboard_key(void *data, struct wl_keyboard *keyboard, uint32_t serial,
+						uint32_t time, uint32_t key, uint32_t state) {
+	(void)keyboard; (void)serial; (void)time; (void)key;
+	if (state != WL_KEYBOARD_KEY_STATE_PRESSED || !bench.key_sent_ns) {
+		return;
+	}
+	uint64_t sent = bench.key_sent_ns;
+	bench.key_sent_ns = 0;
+	bench.keys_received++;
+	histogram_add(&bench.key_event, now_ns() - sent);
+	client_commit(data, sent, 0);
+}
+
+static void keyboard_modifiers(void *data, struct wl_keyboard *keyboard, uint32_t serial,
+							uint32_t depressed, uint32_t latched, uint32_t locked,
+							uint32_t group) {
+	(void)data; (void)keyboard; (void)serial;
+	(void)depressed; (void)latched; (void)locked; (void)group;
+}
+
+static void keyboard_repeat_info(void *data, struct wl_keyboard *keyboard,
+								int32_t rate, int32_t delay) {
+	(void)data; (void)keyboard; (void)rate; (void)delay;
+}
+
+static const struct wl_keyboard_listener keyboard_listener = {
+	.keymap = keyboard_keymap,
+	.enter = keyboard_enter,
+	.leave = keyboard_leave,
+	.key = keyboard_key,
+	.modifiers = keyboard_modifiers,
+	.repeat_info = keyboard_repeat_info,
+};
+
+/* Pointer */
+
+static void pointer_enter(void *data, struct wl_pointer *pointer, uint32_t serial,
+						struct wl_surface *surface, wl_fixed_t x, wl_fixed_t y) {
+	(void)data; (void)pointer; (void)serial; (void)surface; (void)x; (void)y;
+}
+
+static void pointer_leave(void *data, struct wl_pointer *pointer, uint32_t serial,
+						struct wl_surface *surface) {
+	(void)data; (void)pointer; (void)serial; (void)surface;
+}
+
+static void pointer_motion(void *data, struct wl_pointer *pointer, uint32_t time,
+						wl_fixed_t x, wl_fixed_t y) {
+	(void)pointer; (void)time; (void)x; (void)y;
+	if (!bench.motion_sent_ns) {
+		return;
+	}
+	uint64_t sent = bench.motion_sent_ns;
+	bench.motion_sent_ns = 0;
+	bench.motions_received++;
+	histogram_add(&bench.motion_event, now_ns() - sent);
+	client_commit(data, 0, sent);
+}
+
+static void pointer_button(void *data, struct wl_pointer *pointer, uint32_t serial,
+						uint32_t time, uint32_t button, uint32_t state) {
+	(void)data; (void)pointer; (void)serial; (void)time; (void)button; (void)state;
+}
+
+static void pointer_axis(void *data, struct wl_pointer *pointer, uint32_t time,
+						uint32_t axis, wl_fixed_t value) {
+	(void)data; (void)pointer; (void)time; (void)axis; (void)value;
+}
+
+static void pointer_frame(void *data, struct wl_pointer *pointer) {
+	(void)data; (void)pointer;
+}
+
+static void pointer_axis_source(void *data, struct wl_pointer *pointer, uint32_t source) {
+	(void)data; (void)pointer; (void)source;
+}
+
+static void pointer_axis_stop(void *data, struct wl_pointer *pointer, uint32_t time,
+							uint32_t axis) {
+	(void)data; (void)pointer; (void)time; (void)axis;
+}
+
+static void pointer_axis_discrete(void *data, struct wl_pointer *pointer, uint32_t axis,
+								int32_t discrete) {
+	(void)data; (void)pointer; (void)axis; (void)discrete;
+}
+
+static const struct wl_pointer_listener pointer_listener = {
+	.enter = pointer_enter,
+	.leave = pointer_leave,
+	.motion = pointer_motion,
+	.button = pointer_button,
+	.axis = pointer_axis,
+	.frame = pointer_frame,
+	.axis_source = pointer_axis_source,
+	.axis_stop = pointer_axis_stop,
+	.axis_discrete = pointer_axis_discrete,
+};
+
+/* Seat, shell and registry */
+
+static void seat_capabilities(void *data, struct wl_seat *seat, uint32_t capabilities) {
+	struct bench_client *client = data;
+	if (client == &bench.control) {
+		return;
+	}
+	if ((capabilities & WL_SEAT_CAPABILITY_KEYBOARD) && !client->keyboard) {
+		client->keyboard = wl_seat_get_keyboard(seat);
+		wl_keyboard_add_listener(client->keyboard, &keyboard_listener, client);
+	}
+	if ((capabilities & WL_SEAT_CAPABILITY_POINTER) && !client->pointer) {
+		client->pointer = wl_seat_get_pointer(seat);
+		wl_pointer_add_listener(client->pointer, &pointer_listener, client);
+	}
+}
+
+static void seat_name(void *data, struct wl_seat *seat, const char *name) {
+	(void)data; (void)seat; (void)name;
+}
+
+static const struct wl_seat_listener seat_listener = {
+	.capabilities = seat_capabilities,
+	.name = seat_name,
+};
+
+static void wm_base_ping(void *data, struct xdg_wm_base *wm_base, uint32_t serial) {
+	(void)data;
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = wm_base_ping,
+};
+
+static void xdg_surface_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial) {
+	struct bench_client *client = data;
+	xdg_surface_ack_configure(xdg_surface, serial);
+	if (!client->configured) {
+		client->configured = true;
+		client_commit(client, 0, 0);
+	}
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_configure,
+};
+
+/* The clients keep their buffer size, a resize is not what is measured here */
+static void toplevel_configure(void *data, struct xdg_toplevel *toplevel, int32_t width,
+							int32_t height, struct wl_array *states) {
+	(void)data; (void)toplevel; (void)width; (void)height; (void)states;
+}
+
+static void toplevel_close(void *data, struct xdg_toplevel *toplevel) {
+	(void)data; (void)toplevel;
+}
+
+static const struct xdg_toplevel_listener toplevel_listener = {
+	.configure = toplevel_configure,
+	.close = toplevel_close,
+};
+
+static void registry_global(void *data, struct wl_registry *registry, uint32_t name,
+							const char *interface, uint32_t version) {
+	(void)version;
+	struct bench_client *client = data;
+	if (strcmp(interface, wl_compositor_interface.name) == 0) {
+		client->compositor = wl_registry_bind(registry, name, &wl_compositor_interface, 4);
+	} else if (strcmp(interface, wl_shm_interface.name) == 0) {
+		client->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, wl_seat_interface.name) == 0 && !client->seat) {
+		client->seat = wl_registry_bind(registry, name, &wl_seat_interface, 5);
+		wl_seat_add_listener(client->seat, &seat_listener, client);
+	} else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+		client->wm_base = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(client->wm_base, &wm_base_listener, client);
+	} else if (client == &bench.control &&
+			strcmp(interface, zwp_virtual_keyboard_manager_v1_interface.name) == 0) {
+		bench.keyboard_mgr = wl_registry_bind(registry, name,
+											&zwp_virtual_keyboard_manager_v1_interface, 1);
+	} else if (client == &bench.control &&
+			strcmp(interface, zwlr_virtual_pointer_manager_v1_interface.name) == 0) {
+		bench.pointer_mgr = wl_registry_bind(registry, name,
+											&zwlr_virtual_pointer_manager_v1_interface, 1);
+	}
+}
+
+static void registry_global_remove(void *data, struct wl_registry *registry, uint32_t name) {
+	(void)data; (void)registry; (void)name;
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_global,
+	.global_remove = registry_global_remove,
+};
+
+static bool client_connect(struct bench_client *client) {
+	client->display = wl_display_connect(NULL);
+	if (!client->display) {
+		fprintf(stderr, "Error: Failed to connect to woodland!\n");
+		return false;
+	}
+	client->registry = wl_display_get_registry(client->display);
+	wl_registry_add_listener(client->registry, &registry_listener, client);
+	wl_display_roundtrip(client->display);
+	return true;
+}
+
+/* Maps a toplevel of the benchmark size, the app_id matches its window_place */
+static bool client_start(struct bench_client *client) {
+	if (!client_connect(client)) {
+		return false;
+	}
+	if (!client->compositor || !client->shm || !client->wm_base) {
+		fprintf(stderr, "Error: woodland lacks a required global!\n");
+		return false;
+	}
+	client->width = bench.width;
+	client->height = bench.height;
+	if (!client_create_buffers(client)) {
+		fprintf(stderr, "Error: Failed to create SHM buffers!\n");
+		return false;
+	}
+	char app_id[32];
+	snprintf(app_id, sizeof(app_id), "bench-%d", client->index);
+	client->surface = wl_compositor_create_surface(client->compositor);
+	client->xdg_surface = xdg_wm_base_get_xdg_surface(client->wm_base, client->surface);
+	xdg_surface_add_listener(client->xdg_surface, &xdg_surface_listener, client);
+	client->toplevel = xdg_surface_get_toplevel(client->xdg_surface);
+	xdg_toplevel_add_listener(client->toplevel, &toplevel_listener, client);
+	xdg_toplevel_set_app_id(client->toplevel, app_id);
+	xdg_toplevel_set_title(client->toplevel, app_id);
+	wl_surface_commit(client->surface);
+	wl_display_roundtrip(client->display);
+	return true;
+}
+
+static void client_stop(struct bench_client *client) {
+	if (!client->display) {
+		return;
+	}
+	wl_display_disconnect(client->display);
+	client->display = NULL;
+}
+
+/* Virtual input */
+
+static bool control_start(void) {
+	if (!client_connect(&bench.control)) {
+		return false;
+	}
+	if (!bench.keyboard_mgr || !bench.pointer_mgr || !bench.control.seat) {
+		fprintf(stderr, "Error: woodland lacks the virtual keyboard or pointer manager!\n");
+		return false;
+	}
+	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+	struct xkb_keymap *keymap = context ?
+		xkb_keymap_new_from_names(context, NULL, XKB_KEYMAP_COMPILE_NO_FLAGS) : NULL;
+	char *string = keymap ? xkb_keymap_get_as_string(keymap, XKB_KEYMAP_FORMAT_TEXT_V1) : NULL;
+	xkb_keymap_unref(keymap);
+	xkb_context_unref(context);
+	if (!string) {
+		fprintf(stderr, "Error: Failed to compile the keymap!\n");
+		return false;
+	}
+	size_t size = strlen(string) + 1;
+	int fd = create_shm_file(size);
+	if (fd < 0 || write(fd, string, size) != (ssize_t)size) {
+		fprintf(stderr, "Error: Failed to share the keymap!\n");
+		free(string);
+		return false;
+	}
+	free(string);
+
+	bench.virtual_keyboard = zwp_virtual_keyboard_manager_v1_create_virtual_keyboard(
+											bench.keyboard_mgr, bench.control.seat);
+	zwp_virtual_keyboard_v1_keymap(bench.virtual_keyboard, WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1,
+								fd, size);
+	close(fd);
+	bench.virtual_pointer = zwlr_virtual_pointer_manager_v1_create_virtual_pointer(
+											bench.pointer_mgr, bench.control.seat);
+	wl_display_roundtrip(bench.control.display);
+	return true;
+}
+
+static void send_key(void) {
+	if (!bench.focused) {
+		return;
+	}
+	uint32_t time = now_ms();
+	bench.key_sent_ns = now_ns();
+	bench.keys_sent++;
+	zwp_virtual_keyboard_v1_key(bench.virtual_keyboard, time, KEY_A, WL_KEYBOARD_KEY_STATE_PRESSED);
+	zwp_virtual_keyboard_v1_key(bench.virtual_keyboard, time, KEY_A, WL_KEYBOARD_KEY_STATE_RELEASED);
+	wl_display_flush(bench.control.display);
+}
+
+/* Circles the pointer inside the focused window, so every step is a motion
+ * event for the same surface.
+ */
+static void send_motion(void) {
+	static unsigned step;
+	struct bench_client *client = bench.focused;
+	if (!client) {
+		return;
+	}
+	double angle = (step++ % 64) * (2 * M_PI / 64);
+	double radius = (client->width < client->height ? client->width : client->height) / 4.0;
+	int x = client->x + client->width / 2 + (int)(radius * cos(angle));
+	int y = client->y + client->height / 2 + (int)(radius * sin(angle));
+	if (x < 0 || y < 0 || x >= OUTPUT_WIDTH || y >= OUTPUT_HEIGHT) {
+		return;
+	}
+	bench.motion_sent_ns = now_ns();
+	bench.motions_sent++;
+	zwlr_virtual_pointer_v1_motion_absolute(bench.virtual_pointer, now_ms(), x, y,
+										OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	zwlr_virtual_pointer_v1_frame(bench.virtual_pointer);
+	wl_display_flush(bench.control.display);
+}
+
+/* woodland */
+
+/* Writes woodland.ini with a window_place line per client laid out on a grid */
+static bool write_config(void) {
+	char path[128];
+	snprintf(path, sizeof(path), "%s/.config", bench.tmpdir);
+	mkdir(path, 0700);
+	snprintf(path, sizeof(path), "%s/.config/woodland", bench.tmpdir);
+	mkdir(path, 0700);
+	snprintf(path, sizeof(path), "%s/.config/woodland/woodland.ini", bench.tmpdir);
+	FILE *config = fopen(path, "w");
+	if (!config) {
+		return false;
+	}
+	fprintf(config, "[ Idle ]\nidle_timeout = 0\n");
+	fprintf(config, "[ Rendering ]\ncpu_render_threads = %d\n", bench.cpu_threads);
+	fprintf(config, "[ Window placement ]\n");
+	int columns = (int)ceil(sqrt(bench.num_clients));
+	int rows = (bench.num_clients + columns - 1) / columns;
+	for (int i = 0; i < bench.num_clients; i++) {
+		struct bench_client *client = &bench.clients[i];
+		client->index = i;
+		client->x = (i % columns) * (OUTPUT_WIDTH / columns);
+		client->y = (i / columns) * (OUTPUT_HEIGHT / rows);
+		fprintf(config, "window_place = app_id: bench-%d %d %d\n", i, client->x, client->y);
+	}
+	fclose(config);
+	return true;
+}
+
+/* Starts woodland headless, its startup command writes the socket name once
+ * the display is ready.
+ */
+static bool start_woodland(void) {
+	char log_path[128], startup[256], ready_path[128];
+	snprintf(log_path, sizeof(log_path), "%s/woodland.log", bench.tmpdir);
+	snprintf(ready_path, sizeof(ready_path), "%s/display", bench.tmpdir);
+	snprintf(startup, sizeof(startup), "sh -c \"echo $WAYLAND_DISPLAY > %s.tmp && mv %s.tmp %s\"",
+			ready_path, ready_path, ready_path);
+
+	bench.pid = fork();
+	if (bench.pid < 0) {
+		return false;
+	}
+	if (bench.pid == 0) {
+		int fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		if (fd >= 0) {
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+			close(fd);
+		}
+		setenv("WLR_BACKENDS", "headless", true);
+		setenv("WLR_RENDERER", "pixman", true);
+		setenv("WLR_HEADLESS_OUTPUTS", "1", true);
+		setenv("WLR_LIBINPUT_NO_DEVICES", "1", true);
+		execl(bench.woodland, bench.woodland, "-s", startup, (char *)NULL);
+		_exit(127);
+	}
+
+	for (int waited = 0; waited < STARTUP_TIMEOUT_MS; waited += 10) {
+		FILE *ready = fopen(ready_path, "r");
+		if (ready) {
+			char name[64] = { 0 };
+			bool ok = fgets(name, sizeof(name), ready) != NULL;
+			fclose(ready);
+			name[strcspn(name, "\n")] = '\0';
+			if (ok && name[0]) {
+				setenv("WAYLAND_DISPLAY", name, true);
+				return true;
+			}
+		}
+		if (waitpid(bench.pid, NULL, WNOHANG) == bench.pid) {
+			bench.pid = 0;
+			break;
+		}
+		usleep(10000);
+	}
+	fprintf(stderr, "Error: woodland did not start!\n");
+	return false;
+}
+
+/* utime + stime of woodland in seconds */
+static double woodland_cpu_seconds(void) {
+	char path[64], buffer[1024];
+	snprintf(path, sizeof(path), "/proc/%d/stat", bench.pid);
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		return 0;
+	}
+	size_t len = fread(buffer, 1, sizeof(buffer) - 1, file);
+	fclose(file);
+	buffer[len] = '\0';
+	// The command name may hold spaces, fields are counted after its ')'
+	char *p = strrchr(buffer, ')');
+	unsigned long utime = 0, stime = 0;
+	if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+					&utime, &stime) != 2) {
+		return 0;
+	}
+	return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+/* VmRSS or VmHWM of woodland in KiB */
+static long woodland_memory(const char *field) {
+	char path[64], line[256];
+	snprintf(path, sizeof(path), "/proc/%d/status", bench.pid);
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		return 0;
+	}
+	long value = 0;
+	size_t len = strlen(field);
+	while (fgets(line, sizeof(line), file)) {
+		if (strncmp(line, field, len) == 0 && line[len] == ':') {
+			value = atol(line + len + 1);
+			break;
+		}
+	}
+	fclose(file);
+	return value;
+}
+
+static void stop_woodland(void) {
+	if (bench.pid <= 0) {
+		return;
+	}
+	kill(bench.pid, SIGTERM);
+	for (int waited = 0; waited < 5000; waited += 10) {
+		if (waitpid(bench.pid, NULL, WNOHANG) == bench.pid) {
+			bench.pid = 0;
+			return;
+		}
+		usleep(10000);
+	}
+	kill(bench.pid, SIGKILL);
+	waitpid(bench.pid, NULL, 0);
+	bench.pid = 0;
+}
+
+/* Prints the histograms woodland logs on shutdown, its timings and the input
+ * latencies up to the screen */
+static void print_woodland_timings(void) {
+	char path[128], line[1024];
+	snprintf(path, sizeof(path), "%s/woodland.log", bench.tmpdir);
+	FILE *file = fopen(path, "r");
+	if (!file) {
+		return;
+	}
+	while (fgets(line, sizeof(line), file)) {
+		char *timing = strstr(line, "Timing ");
+		if (timing) {
+			printf("  %s", timing + strlen("Timing "));
+		}
+		char *latency = strstr(line, "Latency ");
+		if (latency) {
+			printf("  %s", latency);
+		}
+	}
+	fclose(file);
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+	(void)st; (void)flag; (void)ftw;
+	remove(path);
+	return 0;
+}
+
+/* Main loop */
+
+static int create_timer(int rate) {
+	if (rate <= 0) {
+		return -1;
+	}
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	long period = 1000000000l / rate;
+	struct itimerspec spec = {
+		.it_interval = { period / 1000000000l, period % 1000000000l },
+		.it_value = { period / 1000000000l, period % 1000000000l },
+	};
+	timerfd_settime(fd, 0, &spec, NULL);
+	return fd;
+}
+
+static bool timer_expired(struct pollfd *pfd) {
+	uint64_t expirations;
+	return pfd->fd >= 0 && (pfd->revents & POLLIN) &&
+			read(pfd->fd, &expirations, sizeof(expirations)) == sizeof(expirations);
+}
+
+/* Dispatches the connections and fires the commit, key and motion timers
+ * until 'duration' seconds have passed. Returns false if a connection broke.
+ */
+static bool run(uint64_t duration_ns) {
+	enum { COMMIT_TIMER, KEY_TIMER, MOTION_TIMER, CONTROL, CLIENTS };
+	struct pollfd pfds[CLIENTS + MAX_CLIENTS];
+	pfds[COMMIT_TIMER].fd = create_timer(bench.commit_rate);
+	pfds[KEY_TIMER].fd = create_timer(bench.key_rate);
+	pfds[MOTION_TIMER].fd = create_timer(bench.motion_rate);
+	pfds[CONTROL].fd = wl_display_get_fd(bench.control.display);
+	for (int i = 0; i < bench.num_clients; i++) {
+		pfds[CLIENTS + i].fd = wl_display_get_fd(bench.clients[i].display);
+	}
+	int num_pfds = CLIENTS + bench.num_clients;
+	for (int i = 0; i < num_pfds; i++) {
+		pfds[i].events = POLLIN;
+	}
+
+	bool ok = true;
+	uint64_t end = now_ns() + duration_ns;
+	while (ok && now_ns() < end) {
+		for (int i = CONTROL; i < num_pfds; i++) {
+			struct wl_display *display = i == CONTROL ? bench.control.display :
+													bench.clients[i - CLIENTS].display;
+			wl_display_dispatch_pending(display);
+			wl_display_flush(display);
+		}
+		if (poll(pfds, num_pfds, 100) < 0 && errno != EINTR) {
+			break;
+		}
+		for (int i = CONTROL; i < num_pfds; i++) {
+			struct wl_display *display = i == CONTROL ? bench.control.display :
+													bench.clients[i - CLIENTS].display;
+			if ((pfds[i].revents & (POLLIN | POLLHUP | POLLERR)) &&
+										wl_display_dispatch(display) < 0) {
+				fprintf(stderr, "Error: Lost the connection to woodland!\n");
+				ok = false;
+				break;
+			}
+		}
+		if (timer_expired(&pfds[COMMIT_TIMER])) {
+			for (int i = 0; i < bench.num_clients; i++) {
+				client_commit(&bench.clients[i], 0, 0);
+			}
+		}
+		if (timer_expired(&pfds[KEY_TIMER])) {
+			send_key();
+		}
+		if (timer_expired(&pfds[MOTION_TIMER])) {
+			send_motion();
+		}
+	}
+	for (int i = COMMIT_TIMER; i < CONTROL; i++) {
+		if (pfds[i].fd >= 0) {
+			close(pfds[i].fd);
+		}
+	}
+	return ok;
+}
+
+static void print_histogram(const char *name, const struct histogram *histogram) {
+	char buffer[256];
+	histogram_format(histogram, buffer, sizeof(buffer));
+	printf("  %-24s %s\n", name, buffer);
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-c clients] [-r commit Hz] [-k key Hz] [-m motion Hz] "
+					"[-d seconds] [-s WxH] [-t cpu threads] [-w woodland]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+	int c;
+	while ((c = getopt(argc, argv, "c:r:k:m:d:s:t:w:h")) != -1) {
+		switch (c) {
+		case 'c': bench.num_clients = atoi(optarg); break;
+		case 'r': bench.commit_rate = atoi(optarg); break;
+		case 'k': bench.key_rate = atoi(optarg); break;
+		case 'm': bench.motion_rate = atoi(optarg); break;
+		case 'd': bench.duration = atoi(optarg); break;
+		case 't': bench.cpu_threads = atoi(optarg); break;
+		case 'w': bench.woodland = optarg; break;
+		case 's':
+			if (sscanf(optarg, "%dx%d", &bench.width, &bench.height) != 2) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (bench.num_clients < 1 || bench.num_clients > MAX_CLIENTS || bench.duration < 1 ||
+								bench.width < 32 || bench.height < 32) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	snprintf(bench.tmpdir, sizeof(bench.tmpdir), "/tmp/woodland-bench-XXXXXX");
+	if (!mkdtemp(bench.tmpdir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	// Private runtime dir and HOME, the bench never touches the user's session
+	setenv("XDG_RUNTIME_DIR", bench.tmpdir, true);
+	setenv("HOME", bench.tmpdir, true);
+	signal(SIGPIPE, SIG_IGN);
+
+	int status = 1;
+	if (!write_config() || !start_woodland() || !control_start()) {
+		goto out;
+	}
+	for (int i = 0; i < bench.num_clients; i++) {
+		if (!client_start(&bench.clients[i])) {
+			goto out;
+		}
+	}
+	// Last mapped window has the keyboard focus
+	wl_display_roundtrip(bench.clients[bench.num_clients - 1].display);
+
+	printf("woodland-bench: %d clients %dx%d, commit %d Hz, keys %d Hz, motion %d Hz, %d s\n",
+			bench.num_clients, bench.width, bench.height, bench.commit_rate, bench.key_rate,
+			bench.motion_rate, bench.duration);
+	double cpu_start = woodland_cpu_seconds();
+	uint64_t start = now_ns();
+	if (!run((uint64_t)bench.duration * 1000000000ull)) {
+		goto out;
+	}
+	double elapsed = (now_ns() - start) / 1e9;
+	double cpu = woodland_cpu_seconds() - cpu_start;
+	long rss = woodland_memory("VmRSS");
+	long hwm = woodland_memory("VmHWM");
+
+	printf("  commits                  %llu, %llu skipped with both buffers busy\n",
+			(unsigned long long)bench.commits, (unsigned long long)bench.commits_skipped);
+	printf("  keys                     %llu sent, %llu delivered\n",
+			(unsigned long long)bench.keys_sent, (unsigned long long)bench.keys_received);
+	printf("  motions                  %llu sent, %llu delivered\n",
+			(unsigned long long)bench.motions_sent, (unsigned long long)bench.motions_received);
+	print_histogram("commit -> frame done", &bench.commit_frame);
+	print_histogram("key -> client", &bench.key_event);
+	print_histogram("key -> frame done", &bench.key_frame);
+	print_histogram("motion -> client", &bench.motion_event);
+	print_histogram("motion -> frame done", &bench.motion_frame);
+	printf("  woodland CPU             %.2f s in %.2f s (%.1f%%)\n", cpu, elapsed,
+			100.0 * cpu / elapsed);
+	printf("  woodland RSS             %ld KiB, peak %ld KiB\n", rss, hwm);
+	status = 0;
+
+out:
+	for (int i = 0; i < bench.num_clients; i++) {
+		client_stop(&bench.clients[i]);
+	}
+	client_stop(&bench.control);
+	stop_woodland();
+	if (status == 0) {
+		print_woodland_timings();
+		nftw(bench.tmpdir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+	} else {
+		fprintf(stderr, "woodland's log is kept in %s\n", bench.tmpdir);
+	}
+	return status;
+}
@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Launches the startup_command entries of woodland.ini.
+ * Instead of waiting a fixed time after startup, commands are launched as soon
+ * as the backend is running and the first output is in the layout. Commands are
+ * launched all at once unless they are listed in startup_order, e.g:
+ *	startup_order = waybar, wofi
+ * then wofi is only launched after waybar mapped its first surface (or after
+ * startup_order_timeout milliseconds). The time from launch to the first
+ * mapped surface is logged for every autostarted client.
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include "autostart.h"
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static const char *basename_of(const char *path) {
+	const char *slash = strrchr(path, '/');
+	return slash ? slash + 1 : path;
+}
+
+static bool launch_job(struct autostart *autostart, struct autostart_job *job) {
+	job->launched = true;
+	job->launch_ns = now_ns();
+	job->pid = launcher_spawn(autostart->launcher, job->command);
+	if (job->pid < 0) {
+		return false;
+	}
+	wlr_log(WLR_INFO, "Autostart: launched '%s' %.1f ms after startup", job->command->command,
+										(job->launch_ns - autostart->create_ns) / 1e6);
+	return true;
+}
+
+/* Launches the next position of startup_order that has a command */
+static void advance_order(struct autostart *autostart) {
+	while (++autostart->current_order < autostart->num_order_names) {
+		bool waiting = false;
+		struct autostart_job *job;
+		wl_list_for_each(job, &autostart->jobs, link) {
+			if (job->order == autostart->current_order && !job->launched) {
+				waiting |= launch_job(autostart, job);
+			}
+		}
+		if (waiting) {
+			wl_event_source_timer_update(autostart->timeout, autostart->timeout_ms);
+			return;
+		}
+	}
+	wl_event_source_timer_update(autostart->timeout, 0);
+}
+
+static int handle_timeout(void *data) {
+	struct autostart *autostart = data;
+	wlr_log(WLR_INFO, "Autostart: '%s' did not map a surface within %d ms, moving on",
+				autostart->order_names[autostart->current_order], autostart->timeout_ms);
+	advance_order(autostart);
+	return 0;
+}
+
+static void start(struct autostart *autostart) {
+	if (autostart->started || !autostart->backend_ready || !autostart->output_ready) {
+		return;
+	}
+	autostart->started = true;
+	// Everything that is not ordered goes in parallel
+	struct autostart_job *job;
+	wl_list_for_each(job, &autostart->jobs, link) {
+		if (job->order < 0) {
+			launch_job(autostart, job);
+		}
+	}
+	autostart->current_order = -1;
+	advance_order(autostart);
+}
+
+struct autostart *autostart_create(struct wl_event_loop *loop, struct launcher *launcher,
+												const char *order, int timeout_ms) {
+	struct autostart *autostart = calloc(1, sizeof(struct autostart));
+	if (!autostart) {
+		return NULL;
+	}
+	wl_list_init(&autostart->jobs);
+	autostart->launcher = launcher;
+	autostart->timeout_ms = timeout_ms;
+	autostart->create_ns = now_ns();
+	autostart->timeout = wl_event_loop_add_timer(loop, handle_timeout, autostart);
+	if (!autostart->timeout) {
+		wlr_log(WLR_ERROR, "Error: Failed to create timer in 'autostart_create'!");
+		free(autostart);
+		return NULL;
+	}
+
+	// startup_order = a, b, c
+	if (order && order[0] != '\0') {
+		char *copy = strdup(order);
+		size_t count = 1;
+		for (const char *p = order; *p; p++) {
+			count += *p == ',';
+		}
+		autostart->order_names = calloc(count, sizeof(char *));
+		if (copy && autostart->order_names) {
+			char *saveptr = NULL;
+			for (char *name = strtok_r(copy, ", \t", &saveptr); name;
+									name = strtok_r(NULL, ", \t", &saveptr)) {
+				autostart->order_names[autostart->num_order_names++] = strdup(name);
+			}
+		}
+		free(copy);
+	}
+	return autostart;
+}
+
+void autostart_destroy(struct autostart *autostart) {
+	if (!autostart) {
+		return;
+	}
+	struct autostart_job *job, *tmp;
+	wl_list_for_each_safe(job, tmp, &autostart->jobs, link) {
+		if (job->launched && !job->mapped) {
+			wlr_log(WLR_INFO, "Autostart: '%s' never mapped a surface", job->command->command);
+		}
+		wl_list_remove(&job->link);
+		free(job);
+	}
+	for (int i = 0; i < autostart->num_order_names; i++) {
+		free(autostart->order_names[i]);
+	}
+	free(autostart->order_names);
+	wl_event_source_remove(autostart->timeout);
+	free(autostart);
+}
+
+void autostart_add(struct autostart *autostart, struct cmdcache_entry *command) {
+	if (!autostart || !command) {
+		return;
+	}
+	struct autostart_job *job = calloc(1, sizeof(struct autostart_job));
+	if (!job) {
+		return;
+	}
+	job->command = command;
+	job->order = -1;
+	const char *name = basename_of(command->argv[0]);
+	for (int i = 0; i < autostart->num_order_names; i++) {
+		if (strcmp(autostart->order_names[i], name) == 0) {
+			job->order = i;
+			break;
+		}
+	}
+	wl_list_insert(autostart->jobs.prev, &job->link);
+}
+
+void autostart_backend_ready(struct autostart *autostart) {
+	if (autostart) {
+		autostart->backend_ready = true;
+		start(autostart);
+	}
+}
+
+void autostart_output_ready(struct autostart *autostart) {
+	if (autostart) {
+		autostart->output_ready = true;
+		start(autostart);
+	}
+}
+
+void autostart_client_mapped(struct autostart *autostart, pid_t pid) {
+	if (!autostart || !autostart->started || pid <= 0) {
+		return;
+	}
+	struct autostart_job *job;
+	wl_list_for_each(job, &autostart->jobs, link) {
+		if (job->pid != pid || job->mapped) {
+			continue;
+		}
+		job->mapped = true;
+		uint64_t now = now_ns();
+		wlr_log(WLR_INFO, "Autostart: '%s' time-to-first-frame %.1f ms (%.1f ms after startup)",
+						job->command->command, (now - job->launch_ns) / 1e6,
+						(now - autostart->create_ns) / 1e6);
+		if (job->order >= 0 && job->order == autostart->current_order) {
+			advance_order(autostart);
+		}
+		return;
+	}
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef AUTOSTART_H_
+#define AUTOSTART_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <wayland-server-core.h>
+#include "cmdcache.h"
+#include "launcher.h"
+
+/* One startup_command */
+struct autostart_job {
+	struct wl_list link;
+	struct cmdcache_entry *command;
+	int order;					// position in startup_order, -1 if independent
+	pid_t pid;
+	uint64_t launch_ns;
+	bool launched;
+	bool mapped;				// its first surface has been mapped
+};
+
+struct autostart {
+	struct launcher *launcher;
+	struct wl_event_source *timeout;	// stops waiting for a client of startup_order
+	struct wl_list jobs;				// autostart_job::link
+	char **order_names;					// startup_order, executable names
+	int num_order_names;
+	int current_order;					// position of startup_order being waited for
+	int timeout_ms;
+	uint64_t create_ns;
+	bool backend_ready;
+	bool output_ready;
+	bool started;
+};
+
+struct autostart *autostart_create(struct wl_event_loop *loop, struct launcher *launcher,
+												const char *order, int timeout_ms);
+void autostart_destroy(struct autostart *autostart);
+void autostart_add(struct autostart *autostart, struct cmdcache_entry *command);
+
+/* Everything is launched once both have been reported */
+void autostart_backend_ready(struct autostart *autostart);
+void autostart_output_ready(struct autostart *autostart);
+
+/* A client mapped a surface, records time-to-first-frame of autostarted clients */
+void autostart_client_mapped(struct autostart *autostart, pid_t pid);
+
+#endif
@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Background image decoding and scaling off the compositor thread.
+ * A 4K or 8K JPEG takes hundreds of milliseconds to decode, which would freeze
+ * input and rendering if done on the event loop. Images are decoded by a worker
+ * thread, then scaled to the size of the output that asked for them, and the
+ * worker wakes the event loop through an eventfd when the pixels are ready.
+ * The done callback then runs on the compositor thread, where it is safe to
+ * create the texture, and the pixels are freed right after it returns.
+ * The worker keeps the decoded image while jobs are queued, so several outputs
+ * asking at once decode the file once. It is freed when the queue runs empty,
+ * a later mode change decodes the file again rather than holding a full
+ * resolution image for the life of the process.
+ */
+
+#define STB_IMAGE_IMPLEMENTATION // needed for background image implementation
+
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <stb/stb_image.h>
+#include <wlr/util/log.h>
+#include "bgloader.h"
+
+// Around the image in the 'fit' mode, the compositor's clear color
+static const unsigned char fill_color[4] = {26, 26, 26, 255};
+
+static double now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void free_job(struct bgloader_job *job) {
+	free(job->image.pixels);
+	free(job->path);
+	free(job);
+}
+
+static void free_source(struct bgloader *loader) {
+	stbi_image_free(loader->source_image.pixels);
+	free(loader->source_path);
+	loader->source_image = (struct bgloader_image){0};
+	loader->source_path = NULL;
+}
+
+/* Decodes 'path' into the worker's source image unless it is already there */
+static bool load_source(struct bgloader *loader, const char *path) {
+	if (loader->source_path && strcmp(loader->source_path, path) == 0) {
+		return true;
+	}
+	free_source(loader);
+
+	int channels;
+	struct bgloader_image *image = &loader->source_image;
+	image->pixels = stbi_load(path, &image->width, &image->height, &channels, STBI_rgb_alpha);
+	if (!image->pixels) {
+		return false;
+	}
+	image->stride = image->width * 4;
+	loader->source_path = strdup(path);
+	return true;
+}
+
+/* Runs on the worker thread without the lock held */
+static void process_job(struct bgloader *loader, struct bgloader_job *job) {
+	double start = now_ms();
+	job->failed = !load_source(loader, job->path);
+	job->decode_ms = now_ms() - start;
+	if (job->failed || job->width <= 0 || job->height <= 0) {
+		return;
+	}
+	start = now_ms();
+	struct imagescale_image src = {
+		.pixels = loader->source_image.pixels,
+		.width = loader->source_image.width,
+		.height = loader->source_image.height,
+		.stride = loader->source_image.stride,
+	};
+	struct imagescale_image scaled;
+	job->failed = !imagescale_render(&src, job->width, job->height, job->mode, job->format,
+															fill_color, &scaled);
+	if (!job->failed) {
+		job->image = (struct bgloader_image){
+			.pixels = scaled.pixels,
+			.width = scaled.width,
+			.height = scaled.height,
+			.stride = scaled.stride,
+		};
+	}
+	job->scale_ms = now_ms() - start;
+}
+
+static void *worker_main(void *data) {
+	struct bgloader *loader = data;
+	pthread_mutex_lock(&loader->lock);
+	while (true) {
+		while (wl_list_empty(&loader->pending) && !loader->quit) {
+			pthread_cond_wait(&loader->cond, &loader->lock);
+		}
+		if (loader->quit) {
+			break;
+		}
+		struct bgloader_job *job = wl_container_of(loader->pending.next, job, link);
+		wl_list_remove(&job->link);
+		pthread_mutex_unlock(&loader->lock);
+
+		process_job(loader, job);
+
+		pthread_mutex_lock(&loader->lock);
+		// A prefetch keeps the decode for the first output, a scale only for the ones queued
+		if (job->done && wl_list_empty(&loader->pending)) {
+			free_source(loader);
+		}
+		wl_list_insert(loader->finished.prev, &job->link);
+		uint64_t one = 1;
+		if (write(loader->eventfd, &one, sizeof(one)) != sizeof(one)) {
+			wlr_log(WLR_ERROR, "Error: Failed to wake up the event loop in 'worker_main'!");
+		}
+	}
+	pthread_mutex_unlock(&loader->lock);
+	return NULL;
+}
+
+static int handle_finished(int fd, uint32_t mask, void *data) {
+	(void)mask;
+	struct bgloader *loader = data;
+	uint64_t count;
+	if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+		return 0;
+	}
+
+	struct wl_list finished;
+	wl_list_init(&finished);
+	pthread_mutex_lock(&loader->lock);
+	if (!wl_list_empty(&loader->finished)) {
+		// Take the whole list, the worker keeps going while the callbacks run
+		finished.next = loader->finished.next;
+		finished.prev = loader->finished.prev;
+		finished.next->prev = &finished;
+		finished.prev->next = &finished;
+		wl_list_init(&loader->finished);
+	}
+	pthread_mutex_unlock(&loader->lock);
+
+	struct bgloader_job *job, *tmp;
+	wl_list_for_each_safe(job, tmp, &finished, link) {
+		if (job->failed) {
+			wlr_log(WLR_ERROR, "Failed to load or scale background image: %s", job->path);
+		}
+		else if (job->done) {
+			wlr_log(WLR_INFO, "Scaled %s to %dx%d in %.1f ms (decoded in %.1f ms)", job->path,
+							job->image.width, job->image.height, job->scale_ms, job->decode_ms);
+		}
+		else {
+			wlr_log(WLR_INFO, "Decoded %s in %.1f ms", job->path, job->decode_ms);
+		}
+		if (job->done) {
+			job->done(job->path, job->failed ? NULL : &job->image, job->data);
+		}
+		wl_list_remove(&job->link);
+		free_job(job);
+	}
+	return 0;
+}
+
+struct bgloader *bgloader_create(struct wl_event_loop *loop) {
+	struct bgloader *loader = calloc(1, sizeof(struct bgloader));
+	if (!loader) {
+		return NULL;
+	}
+	wl_list_init(&loader->pending);
+	wl_list_init(&loader->finished);
+	pthread_mutex_init(&loader->lock, NULL);
+	pthread_cond_init(&loader->cond, NULL);
+
+	loader->eventfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (loader->eventfd < 0) {
+		wlr_log(WLR_ERROR, "Error: Failed to create eventfd in 'bgloader_create'!");
+		free(loader);
+		return NULL;
+	}
+	loader->source = wl_event_loop_add_fd(loop, loader->eventfd, WL_EVENT_READABLE,
+														handle_finished, loader);
+	if (!loader->source) {
+		wlr_log(WLR_ERROR, "Error: Failed to add eventfd source in 'bgloader_create'!");
+		close(loader->eventfd);
+		free(loader);
+		return NULL;
+	}
+	if (pthread_create(&loader->thread, NULL, worker_main, loader) != 0) {
+		wlr_log(WLR_ERROR, "Error: Failed to start worker thread in 'bgloader_create'!");
+		wl_event_source_remove(loader->source);
+		close(loader->eventfd);
+		free(loader);
+		return NULL;
+	}
+	return loader;
+}
+
+void bgloader_destroy(struct bgloader *loader) {
+	if (!loader) {
+		return;
+	}
+	// The worker finishes the image it is decoding, if any, and exits
+	pthread_mutex_lock(&loader->lock);
+	loader->quit = true;
+	pthread_cond_signal(&loader->cond);
+	pthread_mutex_unlock(&loader->lock);
+	pthread_join(loader->thread, NULL);
+
+	struct bgloader_job *job, *tmp;
+	wl_list_for_each_safe(job, tmp, &loader->pending, link) {
+		wl_list_remove(&job->link);
+		free_job(job);
+	}
+	wl_list_for_each_safe(job, tmp, &loader->finished, link) {
+		wl_list_remove(&job->link);
+		free_job(job);
+	}
+	free_source(loader);
+	wl_event_source_remove(loader->source);
+	close(loader->eventfd);
+	pthread_cond_destroy(&loader->cond);
+	pthread_mutex_destroy(&loader->lock);
+	free(loader);
+}
+
+static bool queue_job(struct bgloader *loader, const char *path, int width, int height,
+				enum imagescale_mode mode, enum imagescale_format format,
+										bgloader_done_func_t done, void *data) {
+	if (!loader || !path) {
+		return false;
+	}
+	struct bgloader_job *job = calloc(1, sizeof(struct bgloader_job));
+	if (!job) {
+		return false;
+	}
+	job->path = strdup(path);
+	job->width = width;
+	job->height = height;
+	job->mode = mode;
+	job->format = format;
+	job->done = done;
+	job->data = data;
+	if (!job->path) {
+		free(job);
+		return false;
+	}
+	pthread_mutex_lock(&loader->lock);
+	wl_list_insert(loader->pending.prev, &job->link);
+	pthread_cond_signal(&loader->cond);
+	pthread_mutex_unlock(&loader->lock);
+	return true;
+}
+
+bool bgloader_prefetch(struct bgloader *loader, const char *path) {
+	return queue_job(loader, path, 0, 0, IMAGESCALE_FILL, IMAGESCALE_RGBA, NULL, NULL);
+}
+
+bool bgloader_scale(struct bgloader *loader, const char *path, int width, int height,
+				enum imagescale_mode mode, enum imagescale_format format,
+										bgloader_done_func_t done, void *data) {
+	if (!done || width <= 0 || height <= 0) {
+		return false;
+	}
+	return queue_job(loader, path, width, height, mode, format, done, data);
+}
@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef BGLOADER_H_
+#define BGLOADER_H_
+
+#include <stdbool.h>
+#include <pthread.h>
+#include <wayland-server-core.h>
+#include "imagescale.h"
+
+/* 4 bytes per pixel, RGBA (DRM_FORMAT_ABGR8888) unless scaled to another format */
+struct bgloader_image {
+	unsigned char *pixels;
+	int width;
+	int height;
+	int stride;
+};
+
+/* Called on the event loop with the scaled image, NULL if decoding or scaling
+ * failed. The pixels are freed as soon as the callback returns, upload them
+ * before that.
+ */
+typedef void (*bgloader_done_func_t)(const char *path, const struct bgloader_image *image,
+																		void *data);
+
+struct bgloader_job {
+	struct wl_list link;
+	char *path;
+	int width;						// size of the scaled image, 0 to only decode
+	int height;
+	enum imagescale_mode mode;
+	enum imagescale_format format;
+	bgloader_done_func_t done;		// NULL to only decode
+	void *data;
+	struct bgloader_image image;
+	double decode_ms;				// 0 if the decoded image was reused
+	double scale_ms;
+	bool failed;
+};
+
+struct bgloader {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct wl_list pending;			// waiting for the worker, bgloader_job::link
+	struct wl_list finished;		// waiting for the event loop, bgloader_job::link
+	int eventfd;					// worker -> event loop wakeup
+	struct wl_event_source *source;
+	bool quit;
+	// Decoded image, only touched by the worker, so the outputs queued together
+	// scale from the same decode. Freed once no job is pending.
+	char *source_path;
+	struct bgloader_image source_image;
+};
+
+struct bgloader *bgloader_create(struct wl_event_loop *loop);
+void bgloader_destroy(struct bgloader *loader);
+
+/* Queues an image for decoding on the worker thread, so it is ready when
+ * the first output asks for it.
+ */
+bool bgloader_prefetch(struct bgloader *loader, const char *path);
+/* Queues an image to be decoded (or taken from a decode still held) and scaled to
+ * width x height in 'format' on the worker thread.
+ */
+bool bgloader_scale(struct bgloader *loader, const char *path, int width, int height,
+				enum imagescale_mode mode, enum imagescale_format format,
+										bgloader_done_func_t done, void *data);
+
+#endif
@@ -0,0 +1,237 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Cache of the commands woodland may launch (keybindings, multimedia keys,
+ * startup commands). Each command string is split into argv and its executable
+ * is resolved against $PATH once, so a launch is a single posix_spawn call
+ * without any string work. The $PATH directories are watched with inotify and
+ * an entry is resolved again when an executable of that name is installed,
+ * removed or renamed.
+ * Quoted arguments are supported, build the command with \"%s\":
+ *	foot --title="My terminal"
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <wlr/util/log.h>
+#include "cmdcache.h"
+
+#define DEFAULT_PATH "/usr/local/bin:/usr/bin:/bin"
+#define MAX_ARGS 300
+
+/* Splits the command on spaces into 'buffer', words in double quotes are kept
+ * together. Returns the number of arguments, argv is NULL terminated.
+ */
+static int split_command(const char *command, char *buffer, char *argv[], int max_args) {
+	int argc = 0;
+	size_t len = 0;
+	bool in_quotes = false;
+	bool in_word = false;
+
+	for (const char *p = command; *p != '\0'; p++) {
+		if (*p == '"') {
+			in_quotes = !in_quotes;
+			if (!in_word && argc < max_args - 1) {
+				argv[argc++] = &buffer[len];
+				in_word = true;
+			}
+			continue;
+		}
+		if (*p == ' ' && !in_quotes) {
+			if (in_word) {
+				buffer[len++] = '\0';
+				in_word = false;
+			}
+			continue;
+		}
+		if (!in_word) {
+			if (argc == max_args - 1) {
+				break;
+			}
+			argv[argc++] = &buffer[len];
+			in_word = true;
+		}
+		buffer[len++] = *p;
+	}
+	buffer[len] = '\0';
+	argv[argc] = NULL;
+	return argc;
+}
+
+static bool is_executable(const char *path) {
+	struct stat st;
+	return stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0;
+}
+
+static void resolve_entry(struct cmdcache *cache, struct cmdcache_entry *entry) {
+	free(entry->path);
+	entry->path = NULL;
+	const char *name = entry->argv[0];
+	if (strchr(name, '/')) {
+		entry->path = strdup(name);
+		return;
+	}
+	char path[PATH_MAX];
+	for (size_t i = 0; i < cache->num_dirs; i++) {
+		snprintf(path, sizeof(path), "%s/%s", cache->dirs[i], name);
+		if (is_executable(path)) {
+			entry->path = strdup(path);
+			return;
+		}
+	}
+	wlr_log(WLR_ERROR, "'%s' not found in $PATH", name);
+}
+
+static int handle_inotify(int fd, uint32_t mask, void *data) {
+	(void)mask;
+	struct cmdcache *cache = data;
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	while ((len = read(fd, buffer, sizeof(buffer))) > 0) {
+		for (char *p = buffer; p < buffer + len;) {
+			const struct inotify_event *event = (const struct inotify_event *)p;
+			p += sizeof(struct inotify_event) + event->len;
+			if (event->len == 0) {
+				continue;
+			}
+			// Only commands with this executable name can change
+			struct cmdcache_entry *entry;
+			wl_list_for_each(entry, &cache->entries, link) {
+				if (strcmp(entry->argv[0], event->name) == 0) {
+					resolve_entry(cache, entry);
+					wlr_log(WLR_DEBUG, "'%s' resolved again to %s", entry->argv[0],
+														entry->path ? entry->path : "nothing");
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+static void watch_path(struct cmdcache *cache, struct wl_event_loop *loop) {
+	const char *env_path = getenv("PATH");
+	char *path = strdup(env_path && env_path[0] != '\0' ? env_path : DEFAULT_PATH);
+	if (!path) {
+		return;
+	}
+	size_t count = 1;
+	for (const char *p = path; *p; p++) {
+		count += *p == ':';
+	}
+	cache->dirs = calloc(count, sizeof(char *));
+	if (!cache->dirs) {
+		free(path);
+		return;
+	}
+
+	cache->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (cache->inotify_fd < 0) {
+		wlr_log(WLR_ERROR, "Error: inotify_init1 failed (%s), $PATH changes won't be noticed",
+																		strerror(errno));
+	}
+	else {
+		cache->inotify_source = wl_event_loop_add_fd(loop, cache->inotify_fd,
+										WL_EVENT_READABLE, handle_inotify, cache);
+	}
+
+	char *saveptr = NULL;
+	for (char *dir = strtok_r(path, ":", &saveptr); dir; dir = strtok_r(NULL, ":", &saveptr)) {
+		// Relative entries depend on the working directory, skip them
+		if (dir[0] != '/') {
+			continue;
+		}
+		if (cache->inotify_fd >= 0) {
+			inotify_add_watch(cache->inotify_fd, dir, IN_CREATE | IN_DELETE | IN_ATTRIB |
+											IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+		}
+		cache->dirs[cache->num_dirs++] = strdup(dir);
+	}
+	free(path);
+}
+
+struct cmdcache *cmdcache_create(struct wl_event_loop *loop) {
+	struct cmdcache *cache = calloc(1, sizeof(struct cmdcache));
+	if (!cache) {
+		return NULL;
+	}
+	wl_list_init(&cache->entries);
+	cache->inotify_fd = -1;
+	watch_path(cache, loop);
+	return cache;
+}
+
+void cmdcache_destroy(struct cmdcache *cache) {
+	if (!cache) {
+		return;
+	}
+	struct cmdcache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &cache->entries, link) {
+		wl_list_remove(&entry->link);
+		free(entry->command);
+		free(entry->buffer);
+		free(entry->argv);
+		free(entry->path);
+		free(entry);
+	}
+	if (cache->inotify_source) {
+		wl_event_source_remove(cache->inotify_source);
+	}
+	if (cache->inotify_fd >= 0) {
+		close(cache->inotify_fd);
+	}
+	for (size_t i = 0; i < cache->num_dirs; i++) {
+		free(cache->dirs[i]);
+	}
+	free(cache->dirs);
+	free(cache);
+}
+
+struct cmdcache_entry *cmdcache_add(struct cmdcache *cache, const char *command) {
+	if (!cache || !command) {
+		return NULL;
+	}
+	struct cmdcache_entry *entry;
+	wl_list_for_each(entry, &cache->entries, link) {
+		if (strcmp(entry->command, command) == 0) {
+			return entry;
+		}
+	}
+
+	entry = calloc(1, sizeof(struct cmdcache_entry));
+	if (!entry) {
+		return NULL;
+	}
+	char *argv[MAX_ARGS];
+	entry->command = strdup(command);
+	entry->buffer = malloc(strlen(command) + 1);
+	if (!entry->command || !entry->buffer) {
+		free(entry->command);
+		free(entry->buffer);
+		free(entry);
+		return NULL;
+	}
+	entry->argc = split_command(command, entry->buffer, argv, MAX_ARGS);
+	if (entry->argc == 0) {
+		wlr_log(WLR_ERROR, "Empty command '%s'", command);
+		free(entry->command);
+		free(entry->buffer);
+		free(entry);
+		return NULL;
+	}
+	entry->argv = calloc(entry->argc + 1, sizeof(char *));
+	if (!entry->argv) {
+		free(entry->command);
+		free(entry->buffer);
+		free(entry);
+		return NULL;
+	}
+	memcpy(entry->argv, argv, (entry->argc + 1) * sizeof(char *));
+	resolve_entry(cache, entry);
+	wl_list_insert(cache->entries.prev, &entry->link);
+	return entry;
+}
@@ -0,0 +1,36 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef CMDCACHE_H_
+#define CMDCACHE_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <wayland-server-core.h>
+
+/* A configured command, split and resolved once. Entries live as long as the
+ * cache, so keybindings and the server can keep pointers to them.
+ */
+struct cmdcache_entry {
+	struct wl_list link;
+	char *command;			// as written in woodland.ini
+	char *buffer;			// storage for the argv strings
+	char **argv;			// NULL terminated, argv[0] as written
+	int argc;
+	char *path;				// absolute path of the executable, NULL if not found
+};
+
+struct cmdcache {
+	struct wl_list entries;		// cmdcache_entry::link
+	char **dirs;				// $PATH, in search order
+	size_t num_dirs;
+	int inotify_fd;
+	struct wl_event_source *inotify_source;
+};
+
+struct cmdcache *cmdcache_create(struct wl_event_loop *loop);
+void cmdcache_destroy(struct cmdcache *cache);
+
+/* Returns the entry for the command, adding and resolving it on first use */
+struct cmdcache_entry *cmdcache_add(struct cmdcache *cache, const char *command);
+
+#endif
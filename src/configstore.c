@@ -0,0 +1,230 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Parses woodland.ini once and keeps every 'key = value' pair in memory.
+ * Lookups go through a small open addressing hash table, so reading a value
+ * at runtime costs a hash and a strcmp instead of reopening the file.
+ * Keys that appear several times (startup_command, window_place ...) are
+ * chained in file order and can be walked with config_store_first/next.
+ * Usage:
+ *	struct config_store *conf = config_store_load("/home/user/.config/woodland/woodland.ini");
+ *	int timeout = config_store_get_int(conf, "idle_timeout", 0);
+ *	const char *layouts = config_store_get_string(conf, "xkb_layouts", "us");
+ *	config_store_destroy(conf);
+ * Strings returned by config_store_get_string are owned by the store, don't free them.
+ */
+
+#define MAX_LINE_LENGTH 2048
+
+#include <ctype.h>
+#include <stdio.h>
+#include <locale.h>
+#include <stdlib.h>
+#include <string.h>
+#include "configstore.h"
+
+// FNV-1a, good enough for a few dozen short keys
+static uint32_t hash_key(const char *key) {
+	uint32_t hash = 2166136261u;
+	while (*key) {
+		hash ^= (unsigned char)*key++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Trims whitespace characters in place and returns the new start of the string
+static char *trim_in_place(char *str) {
+	while (isspace((unsigned char)*str)) {
+		str++;
+	}
+	char *end = str + strlen(str);
+	while (end > str && isspace((unsigned char)end[-1])) {
+		*--end = '\0';
+	}
+	return str;
+}
+
+static int find_first(const struct config_store *store, const char *key, uint32_t hash) {
+	if (store->num_buckets == 0) {
+		return -1;
+	}
+	size_t mask = store->num_buckets - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		int index = store->buckets[i];
+		if (index < 0) {
+			return -1;
+		}
+		const struct config_entry *entry = &store->entries[index];
+		if (entry->hash == hash && strcmp(entry->key, key) == 0) {
+			return index;
+		}
+	}
+}
+
+static int append_entry(struct config_store *store, const char *key, const char *value) {
+	if (store->num_entries == store->cap_entries) {
+		size_t cap = store->cap_entries ? store->cap_entries * 2 : 64;
+		struct config_entry *entries = realloc(store->entries, cap * sizeof(*entries));
+		if (!entries) {
+			return -1;
+		}
+		store->entries = entries;
+		store->cap_entries = cap;
+	}
+	struct config_entry *entry = &store->entries[store->num_entries];
+	entry->key = strdup(key);
+	entry->value = strdup(value);
+	if (!entry->key || !entry->value) {
+		free(entry->key);
+		free(entry->value);
+		return -1;
+	}
+	entry->hash = hash_key(key);
+	entry->next_same_key = -1;
+	store->num_entries++;
+	return 0;
+}
+
+// Builds the hash table once all the lines are read, load factor stays below 0.5
+static int build_index(struct config_store *store) {
+	size_t num_buckets = 16;
+	while (num_buckets < store->num_entries * 2) {
+		num_buckets *= 2;
+	}
+	store->buckets = malloc(num_buckets * sizeof(int));
+	if (!store->buckets) {
+		return -1;
+	}
+	for (size_t i = 0; i < num_buckets; i++) {
+		store->buckets[i] = -1;
+	}
+	store->num_buckets = num_buckets;
+
+	// Remembers the last entry of each chain so repeated keys stay in file order
+	int *last = malloc((store->num_entries + 1) * sizeof(int));
+	if (!last) {
+		return -1;
+	}
+	size_t mask = num_buckets - 1;
+	for (size_t n = 0; n < store->num_entries; n++) {
+		struct config_entry *entry = &store->entries[n];
+		for (size_t i = entry->hash & mask;; i = (i + 1) & mask) {
+			int index = store->buckets[i];
+			if (index < 0) {
+				store->buckets[i] = (int)n;
+				last[n] = (int)n;
+				break;
+			}
+			struct config_entry *first = &store->entries[index];
+			if (first->hash == entry->hash && strcmp(first->key, entry->key) == 0) {
+				store->entries[last[index]].next_same_key = (int)n;
+				last[index] = (int)n;
+				break;
+			}
+		}
+	}
+	free(last);
+	return 0;
+}
+
+struct config_store *config_store_load(const char *fullPathToConf) {
+	// Numbers in woodland.ini always use a dot as decimal separator
+	setlocale(LC_NUMERIC, "C");
+
+	struct config_store *store = calloc(1, sizeof(struct config_store));
+	if (!store) {
+		return NULL;
+	}
+
+	FILE *pathToConfig = fopen(fullPathToConf, "r");
+	if (pathToConfig == NULL) {
+		perror("Error opening file");
+		// An empty store still answers every lookup with the fallback value
+		build_index(store);
+		return store;
+	}
+
+	char buffer[MAX_LINE_LENGTH];
+	while (fgets(buffer, sizeof(buffer), pathToConfig) != NULL) {
+		char *line = trim_in_place(buffer);
+		// Ignore comments, section names and empty lines
+		if (line[0] == '#' || line[0] == '[' || line[0] == '\0') {
+			continue;
+		}
+		char *pos = strchr(line, '=');
+		if (pos == NULL) {
+			continue;
+		}
+		*pos = '\0'; // Split the string into key and value
+		char *key = trim_in_place(line);
+		char *value = trim_in_place(pos + 1);
+		if (key[0] == '\0') {
+			continue;
+		}
+		if (append_entry(store, key, value) != 0) {
+			perror("Error storing config entry");
+			break;
+		}
+	}
+	fclose(pathToConfig);
+
+	if (build_index(store) != 0) {
+		perror("Error indexing config");
+		config_store_destroy(store);
+		return NULL;
+	}
+	return store;
+}
+
+void config_store_destroy(struct config_store *store) {
+	if (!store) {
+		return;
+	}
+	for (size_t i = 0; i < store->num_entries; i++) {
+		free(store->entries[i].key);
+		free(store->entries[i].value);
+	}
+	free(store->entries);
+	free(store->buckets);
+	free(store);
+}
+
+const struct config_entry *config_store_first(const struct config_store *store,
+																const char *key) {
+	if (!store || !key) {
+		return NULL;
+	}
+	int index = find_first(store, key, hash_key(key));
+	return index < 0 ? NULL : &store->entries[index];
+}
+
+const struct config_entry *config_store_next(const struct config_store *store,
+															const struct config_entry *entry) {
+	if (!store || !entry || entry->next_same_key < 0) {
+		return NULL;
+	}
+	return &store->entries[entry->next_same_key];
+}
+
+const char *config_store_get_string(const struct config_store *store, const char *key,
+																const char *fallback) {
+	const struct config_entry *entry = config_store_first(store, key);
+	return entry ? entry->value : fallback;
+}
+
+int config_store_get_int(const struct config_store *store, const char *key, int fallback) {
+	const struct config_entry *entry = config_store_first(store, key);
+	if (!entry || entry->value[0] == '\0') {
+		return fallback;
+	}
+	return atoi(entry->value);
+}
+
+double config_store_get_double(const struct config_store *store, const char *key,
+																double fallback) {
+	const struct config_entry *entry = config_store_first(store, key);
+	if (!entry || entry->value[0] == '\0') {
+		return fallback;
+	}
+	return strtod(entry->value, NULL);
+}
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef CONFIGSTORE_H_
+#define CONFIGSTORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* One 'key = value' line of woodland.ini, kept in file order */
+struct config_entry {
+	char *key;
+	char *value;
+	uint32_t hash;
+	int next_same_key; // index of the next entry with the same key, -1 if none
+};
+
+struct config_store {
+	struct config_entry *entries;
+	size_t num_entries;
+	size_t cap_entries;
+	int *buckets; // open addressing table, first entry index per distinct key or -1
+	size_t num_buckets;
+};
+
+struct config_store *config_store_load(const char *fullPathToConf);
+void config_store_destroy(struct config_store *store);
+
+const char *config_store_get_string(const struct config_store *store, const char *key,
+																const char *fallback);
+int config_store_get_int(const struct config_store *store, const char *key, int fallback);
+double config_store_get_double(const struct config_store *store, const char *key,
+																double fallback);
+
+/* Iterating keys that may appear several times, e.g. startup_command */
+const struct config_entry *config_store_first(const struct config_store *store,
+																const char *key);
+const struct config_entry *config_store_next(const struct config_store *store,
+															const struct config_entry *entry);
+
+#endif
@@ -58,7 +58,9 @@ void create_config(void) {
 		fprintf(config, "%s\n", "d_power_path = /sys/class/backlight/intel_backlight/brightness");
 		fprintf(config, "%s\n", "\n[ Background ]");
 		fprintf(config, "%s\n", "# Provide the full path to the image.");
-		fprintf(config, "%s\n", "#background = path\n");
+		fprintf(config, "%s\n", "#background = path");
+		fprintf(config, "%s\n", "# How the image covers each output: fill, fit, tile or stretch.");
+		fprintf(config, "%s\n", "background_mode = fill\n");
 		fprintf(config, "%s\n", "[ Keyboard layouts ]");
 		fprintf(config, "%s\n", "# Alt+Shift to switch layouts");
 		fprintf(config, "%s\n", "# e.g: xkb_layouts=us,de");
@@ -84,7 +86,10 @@ void create_config(void) {
 		fprintf(config, "%s\n", "# Example of user defined shortcuts:");
 		fprintf(config, "%s\n", "# NOTE: You have to preserve binding_ and command_ prefixes.");
 		fprintf(config, "%s\n", "#binding_thunar = WLR_MODIFIER_LOGO XKB_KEY_f");
-		fprintf(config, "%s\n", "#command_thunar = thunar\n");
+		fprintf(config, "%s\n", "#command_thunar = thunar");
+		fprintf(config, "%s\n", "# Modifiers can be combined, e.g. <Ctrl+Alt+t>:");
+		fprintf(config, "%s\n", "#binding_term = WLR_MODIFIER_CTRL WLR_MODIFIER_ALT XKB_KEY_t");
+		fprintf(config, "%s\n", "#command_term = foot\n");
 		fprintf(config, "%s\n", "[ Window Placement ]");
 		fprintf(config, "%s\n", "# Open specified windows at the given fixed position.");
 		fprintf(config, "%s\n", "# to get the title and/or app_id, use wlrctl tool.");
@@ -100,9 +105,15 @@ void create_config(void) {
 		fprintf(config, "%s\n", "# zoom_speed defines how fast zooming area is moving around.");
 		fprintf(config, "%s\n", "# zoom_edge_threshold defines the distance from the edges to start panning.");
 		fprintf(config, "%s\n", "# zoom_top_edge if 'enabled' then you can scroll on the left top edge to zoom.");
+		fprintf(config, "%s\n", "# zoom_filter is 'linear' (smooth) or 'nearest' (sharp pixels), 'nearest' needs the GLES2 renderer.");
 		fprintf(config, "%s\n", "zoom_speed = 5");
 		fprintf(config, "%s\n", "zoom_top_edge = disabled");
-		fprintf(config, "%s\n", "zoom_edge_threshold = 30\n");
+		fprintf(config, "%s\n", "zoom_edge_threshold = 30");
+		fprintf(config, "%s\n", "zoom_filter = linear\n");
+		fprintf(config, "%s\n", "[ Rendering ]");
+		fprintf(config, "%s\n", "# Without a GPU (pixman renderer) frames are composited in tiles on several threads.");
+		fprintf(config, "%s\n", "# cpu_render_threads is the number of threads, 0 uses every core, 1 disables it.");
+		fprintf(config, "%s\n", "cpu_render_threads = 0\n");
 		fprintf(config, "%s\n", "[ Startup ]");
 		fprintf(config, "%s\n", "# Specify the startup commands.");
 		fprintf(config, "%s\n", "# If no startup command is specified then");
@@ -111,7 +122,12 @@ void create_config(void) {
 		fprintf(config, "%s\n", "# Example (automatically start thunar and foot):");
 		fprintf(config, "%s\n", "# NOTE: the line must start with startup_command");
 		fprintf(config, "%s\n", "#startup_command = thunar");
-		fprintf(config, "%s\n", "#startup_command = foot\n");
+		fprintf(config, "%s\n", "#startup_command = foot");
+		fprintf(config, "%s\n", "# Commands start in parallel once the first output is ready.");
+		fprintf(config, "%s\n", "# startup_order lists executables that must show a window before the next");
+		fprintf(config, "%s\n", "# one is launched, startup_order_timeout is how long to wait for it (ms).");
+		fprintf(config, "%s\n", "#startup_order = waybar, wofi");
+		fprintf(config, "%s\n", "#startup_order_timeout = 3000\n");
 		fclose(config);
 
 		// Log that the configuration files were created
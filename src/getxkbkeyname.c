@@ -1,7 +1,12 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
-/* This function returns the XKB key name from the given hexadecimal symbol.
- * the names are defined in: /usr/include/xkbcommon/xkbcommon-keysyms.h
+/* This function returns the XKB key name of the given keysym, the names are the
+ * ones defined in /usr/include/xkbcommon/xkbcommon-keysyms.h (e.g. XKB_KEY_Return).
+ * The name comes from libxkbcommon's own keysym table, so it works without the
+ * -dev package installed and never touches the disk. Resolved names are kept in
+ * a small direct-mapped cache, a key press costs a table probe and no malloc.
+ * The returned string is borrowed: don't free it and copy it if you need it
+ * after the next call.
  * Usage:
  	1) First in your code you need to get the sym:
 	example:
@@ -11,63 +16,49 @@
 		int nsyms = xkb_state_key_get_syms(keyboard->device->keyboard->xkb_state, keycode, &syms);
 		// The sym would be syms[i] in the following loop:
 		for (int i = 0; i < nsyms; i++) {
-			// Check if the Super key is pressed or released
-			if (syms[i] == XKB_KEY_Super_L || syms[i] == XKB_KEY_Super_R) {
-				// do something with syms[i] for instance provide is as argument for a function:
-				// handle_keybinding_super(server, syms[i]);
-			}
-		}
-		2) in your handle function (e.g. handle_keybinding_super) get the hexcode:
-		static bool handle_keybinding_alt(struct woodland_server *server, xkb_keysym_t sym) {
-			char hexCode[256];
-			snprintf(hexCode, sizeof(hexCode), "%#06x", sym);
-			// Get the key name from the hexcode and print it:
-			char *keyname = xkb_keyname(hexCode);
+			const char *keyname = xkb_keyname(syms[i]);
 			if (keyname) {
 				printf("Key name: %s\n", keyname);
-				free(keyname); // Free the allocated memory
 			}
 			else {
-				printf("Key not found or error occurred\n");
+				printf("Key not found\n");
 			}
 		}
  */
 
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
+#include "getxkbkeyname.h"
+
+#define KEYNAME_CACHE_SIZE 256 // must be a power of two
+#define KEYNAME_MAX_LENGTH 64
+
+struct keyname_cache_entry {
+	xkb_keysym_t sym;
+	char name[KEYNAME_MAX_LENGTH];
+};
+
+static struct keyname_cache_entry keyname_cache[KEYNAME_CACHE_SIZE];
+
+const char *xkb_keyname(xkb_keysym_t sym) {
+	if (sym == XKB_KEY_NoSymbol) {
+		return NULL;
+	}
+	struct keyname_cache_entry *entry = &keyname_cache[(sym ^ (sym >> 8)) &
+														(KEYNAME_CACHE_SIZE - 1)];
+	if (entry->sym == sym && entry->name[0] != '\0') {
+		return entry->name;
+	}
 
-char *xkb_keyname(const char *hexadecimal) {
-    FILE *file = fopen("/usr/include/xkbcommon/xkbcommon-keysyms.h", "r");
-    if (!file) {
-        perror("Error opening file");
-        return NULL;
-    }
-    char buffer[256];
-    char *keyname = NULL;
-    while (fgets(buffer, sizeof(buffer), file) != NULL) {
-        // Check if the line contains the provided hexadecimal value
-        if (strstr(buffer, hexadecimal) != NULL) {
-            // Check if the line contains the "#define" keyword
-            char *define_ptr = strstr(buffer, "#define");
-            if (define_ptr) {
-                // Extract the keyname
-                char *start = define_ptr + strlen("#define");
-                while (*start == ' ' || *start == '\t') start++; // Skip whitespace
-                char *end = start;
-                while (*end && *end != ' ' && *end != '\t' && *end != '\n') end++; // Find end of keyname
-                keyname = (char *)malloc(end - start + 1);
-                if (!keyname) {
-                    perror("Memory allocation error");
-                    fclose(file);
-                    return NULL;
-                }
-                strncpy(keyname, start, end - start);
-                keyname[end - start] = '\0';
-                break;
-            }
-        }
-    }
-    fclose(file);
-    return keyname;
+	// Same spelling as the #define in xkbcommon-keysyms.h
+	const size_t prefix_len = strlen("XKB_KEY_");
+	memcpy(entry->name, "XKB_KEY_", prefix_len);
+	int len = xkb_keysym_get_name(sym, entry->name + prefix_len,
+											sizeof(entry->name) - prefix_len);
+	if (len <= 0 || (size_t)len >= sizeof(entry->name) - prefix_len) {
+		entry->name[0] = '\0';
+		return NULL;
+	}
+	entry->sym = sym;
+	return entry->name;
 }
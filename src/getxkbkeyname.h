@@ -2,5 +2,6 @@
 
 #ifndef GETXKBKEYNAME_H_
 #define GETXKBKEYNAME_H_
-char *xkb_keyname(const char *hexadecimal);
+#include <xkbcommon/xkbcommon.h>
+const char *xkb_keyname(xkb_keysym_t sym);
 #endif
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Duration histograms for the timing statistics.
+ * Values below 2^HISTOGRAM_SUB_BITS get a bucket each, above that every power
+ * of two is split into 2^HISTOGRAM_SUB_BITS equal buckets. That covers
+ * nanoseconds to hours with a fixed relative error, so the compositor can
+ * record every frame and every input event and still report tail percentiles.
+ */
+
+#include <stdio.h>
+#include "histogram.h"
+
+#define SUB_BUCKETS (1u << HISTOGRAM_SUB_BITS)
+
+static size_t bucket_index(uint64_t value) {
+	if (value < SUB_BUCKETS) {
+		return (size_t)value;
+	}
+	int shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS;
+	return ((size_t)(shift + 1) << HISTOGRAM_SUB_BITS) +
+						(size_t)((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+/* Middle of the bucket, the best estimate of the values in it */
+static uint64_t bucket_value(size_t index) {
+	if (index < SUB_BUCKETS) {
+		return index;
+	}
+	int shift = (int)(index >> HISTOGRAM_SUB_BITS) - 1;
+	uint64_t lowest = (uint64_t)(SUB_BUCKETS + (index & (SUB_BUCKETS - 1))) << shift;
+	return lowest + (((uint64_t)1 << shift) >> 1);
+}
+
+void histogram_add(struct histogram *histogram, uint64_t value) {
+	histogram->counts[bucket_index(value)]++;
+	histogram->count++;
+	histogram->sum += value;
+	if (value > histogram->max) {
+		histogram->max = value;
+	}
+}
+
+void histogram_merge(struct histogram *histogram, const struct histogram *other) {
+	for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		histogram->counts[i] += other->counts[i];
+	}
+	histogram->count += other->count;
+	histogram->sum += other->sum;
+	if (other->max > histogram->max) {
+		histogram->max = other->max;
+	}
+}
+
+uint64_t histogram_percentile(const struct histogram *histogram, double percentile) {
+	if (histogram->count == 0) {
+		return 0;
+	}
+	uint64_t rank = (uint64_t)(percentile / 100.0 * histogram->count + 0.5);
+	if (rank < 1) {
+		rank = 1;
+	}
+	uint64_t seen = 0;
+	for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += histogram->counts[i];
+		if (seen >= rank) {
+			uint64_t value = bucket_value(i);
+			return value < histogram->max ? value : histogram->max;
+		}
+	}
+	return histogram->max;
+}
+
+void histogram_format(const struct histogram *histogram, char *buffer, size_t size) {
+	snprintf(buffer, size, "%llu samples, p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us",
+				(unsigned long long)histogram->count,
+				histogram_percentile(histogram, 50.0) / 1e3,
+				histogram_percentile(histogram, 90.0) / 1e3,
+				histogram_percentile(histogram, 99.0) / 1e3, histogram->max / 1e3);
+}
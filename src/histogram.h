@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Sub-buckets per power of two, percentiles are within 1/32 of the value */
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+/* Log-linear histogram of durations in nanoseconds, adding a sample is a
+ * couple of instructions and never allocates. Zero initialized is empty.
+ */
+struct histogram {
+	uint64_t counts[HISTOGRAM_BUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+};
+
+void histogram_add(struct histogram *histogram, uint64_t value);
+void histogram_merge(struct histogram *histogram, const struct histogram *other);
+/* Value below which 'percentile' (0 to 100) percent of the samples are */
+uint64_t histogram_percentile(const struct histogram *histogram, double percentile);
+/* "N samples, p50 X us, p90 X us, p99 X us, max X us" */
+void histogram_format(const struct histogram *histogram, char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Spatial index for pointer hit-testing.
+ * Each output has a grid of HITGRID_CELL_SIZE cells over its part of the
+ * layout. Views and layer surfaces are entered into every cell their bounding
+ * box touches when they are mapped, moved or resized, so a pointer event only
+ * looks at the few items of the cell under the cursor instead of walking every
+ * surface tree. The grid knows nothing about stacking, the caller orders the
+ * candidates.
+ */
+
+#include <stdlib.h>
+#include <wlr/util/log.h>
+#include "hitgrid.h"
+
+static void free_cells(struct hitgrid *grid) {
+	for (int i = 0; i < grid->columns * grid->rows; i++) {
+		free(grid->cells[i].items);
+	}
+	free(grid->cells);
+	grid->cells = NULL;
+	grid->columns = 0;
+	grid->rows = 0;
+}
+
+struct hitgrid *hitgrid_create(const struct wlr_box *area) {
+	struct hitgrid *grid = calloc(1, sizeof(struct hitgrid));
+	if (!grid) {
+		return NULL;
+	}
+	hitgrid_reset(grid, area);
+	return grid;
+}
+
+void hitgrid_destroy(struct hitgrid *grid) {
+	if (!grid) {
+		return;
+	}
+	free_cells(grid);
+	free(grid);
+}
+
+void hitgrid_reset(struct hitgrid *grid, const struct wlr_box *area) {
+	free_cells(grid);
+	grid->area = *area;
+	grid->complete = true;
+	if (area->width <= 0 || area->height <= 0) {
+		return;
+	}
+	int columns = (area->width + HITGRID_CELL_SIZE - 1) / HITGRID_CELL_SIZE;
+	int rows = (area->height + HITGRID_CELL_SIZE - 1) / HITGRID_CELL_SIZE;
+	grid->cells = calloc((size_t)columns * rows, sizeof(struct hitgrid_cell));
+	if (!grid->cells) {
+		wlr_log(WLR_ERROR, "Error: Failed to allocate memory in 'hitgrid_reset'!");
+		grid->complete = false;
+		return;
+	}
+	grid->columns = columns;
+	grid->rows = rows;
+}
+
+/* Range of cells the box touches, false if it is outside the area */
+static bool cell_range(const struct hitgrid *grid, const struct wlr_box *box,
+					int *x1, int *y1, int *x2, int *y2) {
+	struct wlr_box clipped;
+	if (!grid->cells || !wlr_box_intersection(&clipped, box, &grid->area)) {
+		return false;
+	}
+	*x1 = (clipped.x - grid->area.x) / HITGRID_CELL_SIZE;
+	*y1 = (clipped.y - grid->area.y) / HITGRID_CELL_SIZE;
+	*x2 = (clipped.x + clipped.width - 1 - grid->area.x) / HITGRID_CELL_SIZE;
+	*y2 = (clipped.y + clipped.height - 1 - grid->area.y) / HITGRID_CELL_SIZE;
+	return true;
+}
+
+void hitgrid_insert(struct hitgrid *grid, void *item, const struct wlr_box *box) {
+	int x1, y1, x2, y2;
+	if (!cell_range(grid, box, &x1, &y1, &x2, &y2)) {
+		return;
+	}
+	for (int y = y1; y <= y2; y++) {
+		for (int x = x1; x <= x2; x++) {
+			struct hitgrid_cell *cell = &grid->cells[y * grid->columns + x];
+			if (cell->num_items == cell->cap_items) {
+				size_t cap = cell->cap_items ? cell->cap_items * 2 : 4;
+				void **items = realloc(cell->items, cap * sizeof(void *));
+				if (!items) {
+					wlr_log(WLR_ERROR, "Error: Failed to allocate memory in 'hitgrid_insert'!");
+					grid->complete = false;
+					continue;
+				}
+				cell->items = items;
+				cell->cap_items = cap;
+			}
+			cell->items[cell->num_items++] = item;
+		}
+	}
+}
+
+void hitgrid_remove(struct hitgrid *grid, void *item, const struct wlr_box *box) {
+	int x1, y1, x2, y2;
+	if (!cell_range(grid, box, &x1, &y1, &x2, &y2)) {
+		return;
+	}
+	for (int y = y1; y <= y2; y++) {
+		for (int x = x1; x <= x2; x++) {
+			struct hitgrid_cell *cell = &grid->cells[y * grid->columns + x];
+			for (size_t i = 0; i < cell->num_items; i++) {
+				if (cell->items[i] == item) {
+					cell->items[i] = cell->items[--cell->num_items];
+					break;
+				}
+			}
+		}
+	}
+}
+
+bool hitgrid_query(const struct hitgrid *grid, double x, double y, void ***items, size_t *count) {
+	if (!grid->complete || !grid->cells || !wlr_box_contains_point(&grid->area, x, y)) {
+		return false;
+	}
+	int column = (int)(x - grid->area.x) / HITGRID_CELL_SIZE;
+	int row = (int)(y - grid->area.y) / HITGRID_CELL_SIZE;
+	// The cursor can sit on the last fraction of a pixel of the area
+	if (column >= grid->columns) {
+		column = grid->columns - 1;
+	}
+	if (row >= grid->rows) {
+		row = grid->rows - 1;
+	}
+	struct hitgrid_cell *cell = &grid->cells[row * grid->columns + column];
+	*items = cell->items;
+	*count = cell->num_items;
+	return true;
+}
@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef HITGRID_H_
+#define HITGRID_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <wlr/util/box.h>
+
+/* Side of a grid cell in pixels, a window covers a few dozen cells */
+#define HITGRID_CELL_SIZE 128
+
+struct hitgrid_cell {
+	void **items;
+	size_t num_items;
+	size_t cap_items;
+};
+
+/* Uniform grid over an area, every cell lists the items whose box touches it */
+struct hitgrid {
+	struct wlr_box area;
+	int columns;
+	int rows;
+	struct hitgrid_cell *cells;
+	bool complete;					// false once an insert failed, until the next reset
+};
+
+struct hitgrid *hitgrid_create(const struct wlr_box *area);
+void hitgrid_destroy(struct hitgrid *grid);
+/* Empties the grid and makes it cover 'area' */
+void hitgrid_reset(struct hitgrid *grid, const struct wlr_box *area);
+
+/* 'box' is clipped to the area, remove must be given the box of the insert */
+void hitgrid_insert(struct hitgrid *grid, void *item, const struct wlr_box *box);
+void hitgrid_remove(struct hitgrid *grid, void *item, const struct wlr_box *box);
+
+/* Items whose box touches the cell of (x, y), in no particular order. Returns
+ * false when the grid can't answer: the point is outside or the grid is not
+ * complete, the caller then has to look at every item.
+ */
+bool hitgrid_query(const struct hitgrid *grid, double x, double y, void ***items, size_t *count);
+
+#endif
@@ -0,0 +1,468 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Background image resampling.
+ * The background is scaled once per output to the output's resolution, so a
+ * frame draws a texture of exactly the output's size instead of sampling a
+ * full resolution photo down every time. The scaler is separable: a
+ * horizontal pass into a temporary image, then a vertical pass, each output
+ * pixel being a weighted sum of source pixels with a triangle (tent) filter.
+ * When shrinking, the filter widens to cover every source pixel, which avoids
+ * the aliasing a plain bilinear lookup has on large downscales. Weights are
+ * precomputed per column and per row in 14 bit fixed point.
+ * The inner loops have SSE2 and AVX2 versions, picked at compile time from
+ * -march, with the scalar code as fallback. Source pixels are widened to 16
+ * bits and multiplied in pairs with _mm_madd_epi16: two neighbouring pixels
+ * in the horizontal pass, the same bytes of two rows in the vertical one. The
+ * vertical pass also converts to the renderer's byte order while storing, so
+ * the result goes to the texture as is.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "imagescale.h"
+
+#define WEIGHT_BITS 14
+#define WEIGHT_ONE (1 << WEIGHT_BITS)
+
+/* Source pixels contributing to one destination column or row */
+struct contrib {
+	int start;
+	int count;
+};
+
+struct filter {
+	struct contrib *contribs;	// one per destination pixel
+	int16_t *weights;			// 'max_count' per destination pixel
+	int max_count;
+};
+
+static void filter_destroy(struct filter *filter) {
+	free(filter->contribs);
+	free(filter->weights);
+}
+
+static bool filter_create(struct filter *filter, int src_size, int dst_size) {
+	double scale = (double)dst_size / src_size;
+	// Radius of the tent in source pixels, wider than one pixel when shrinking
+	double support = scale < 1.0 ? 1.0 / scale : 1.0;
+	filter->max_count = (int)ceil(support * 2.0) + 1;
+	filter->contribs = calloc(dst_size, sizeof(struct contrib));
+	filter->weights = calloc((size_t)dst_size * filter->max_count, sizeof(int16_t));
+	double *scratch = calloc(filter->max_count, sizeof(double));
+	if (!filter->contribs || !filter->weights || !scratch) {
+		filter_destroy(filter);
+		free(scratch);
+		return false;
+	}
+
+	for (int i = 0; i < dst_size; i++) {
+		double center = (i + 0.5) / scale;
+		int start = (int)floor(center - support);
+		int end = (int)ceil(center + support);
+		if (start < 0) {
+			start = 0;
+		}
+		if (end > src_size) {
+			end = src_size;
+		}
+		int count = 0;
+		double sum = 0.0;
+		for (int j = start; j < end && count < filter->max_count; j++) {
+			double weight = 1.0 - fabs((j + 0.5 - center) / support);
+			scratch[count++] = weight > 0.0 ? weight : 0.0;
+			sum += scratch[count - 1];
+		}
+		int16_t *weights = &filter->weights[(size_t)i * filter->max_count];
+		if (sum <= 0.0) {
+			// Can only happen on the edges, take the nearest source pixel
+			int nearest = (int)center < src_size ? (int)center : src_size - 1;
+			filter->contribs[i] = (struct contrib){ .start = nearest, .count = 1 };
+			weights[0] = WEIGHT_ONE;
+			continue;
+		}
+		// Quantize, the rounding error goes to the largest weight so they sum to one
+		int total = 0;
+		int largest = 0;
+		for (int k = 0; k < count; k++) {
+			weights[k] = (int16_t)lround(scratch[k] / sum * WEIGHT_ONE);
+			total += weights[k];
+			if (weights[k] > weights[largest]) {
+				largest = k;
+			}
+		}
+		weights[largest] += WEIGHT_ONE - total;
+		filter->contribs[i] = (struct contrib){ .start = start, .count = count };
+	}
+	free(scratch);
+	return true;
+}
+
+static inline unsigned char clamp_pixel(int32_t value) {
+	value = (value + WEIGHT_ONE / 2) >> WEIGHT_BITS;
+	return value < 0 ? 0 : value > 255 ? 255 : (unsigned char)value;
+}
+
+#if defined(__SSE2__)
+/* Two 16 bit weights for _mm_madd_epi16, 'first' in the low half */
+static inline int32_t weight_pair(int16_t first, int16_t second) {
+	return (int32_t)((uint32_t)(uint16_t)first | ((uint32_t)(uint16_t)second << 16));
+}
+
+/* Swaps bytes 0 and 2 of every pixel of 'v', widened to 16 bits */
+#define SWAP_RB_EPI16(v) _mm_shufflehi_epi16(_mm_shufflelo_epi16((v), \
+											_MM_SHUFFLE(3, 0, 1, 2)), _MM_SHUFFLE(3, 0, 1, 2))
+#endif
+
+static void resize_horizontal(const struct imagescale_image *src,
+						const struct imagescale_image *dst, const struct filter *filter) {
+#if defined(__SSE2__)
+	// One output pixel fills a register, so this pass stays 128 bit with AVX2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi32(WEIGHT_ONE / 2);
+#endif
+	for (int y = 0; y < src->height; y++) {
+		const unsigned char *src_row = src->pixels + (size_t)y * src->stride;
+		unsigned char *dst_row = dst->pixels + (size_t)y * dst->stride;
+		for (int x = 0; x < dst->width; x++) {
+			const struct contrib *contrib = &filter->contribs[x];
+			const int16_t *weights = &filter->weights[(size_t)x * filter->max_count];
+			const unsigned char *pixel = src_row + contrib->start * 4;
+#if defined(__SSE2__)
+			__m128i sum = zero;
+			int k = 0;
+			for (; k + 1 < contrib->count; k += 2, pixel += 8) {
+				// r0 g0 b0 a0 r1 g1 b1 a1 -> r0 r1 g0 g1 b0 b1 a0 a1
+				__m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)pixel), zero);
+				v = _mm_unpacklo_epi16(v, _mm_srli_si128(v, 8));
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(v,
+										_mm_set1_epi32(weight_pair(weights[k], weights[k + 1]))));
+			}
+			if (k < contrib->count) {
+				// Last odd pixel, never read past it as it may end the image
+				int32_t last;
+				memcpy(&last, pixel, sizeof(last));
+				__m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(last), zero);
+				v = _mm_unpacklo_epi16(v, zero);
+				sum = _mm_add_epi32(sum, _mm_madd_epi16(v,
+													_mm_set1_epi32(weight_pair(weights[k], 0))));
+			}
+			sum = _mm_srai_epi32(_mm_add_epi32(sum, round), WEIGHT_BITS);
+			sum = _mm_packs_epi32(sum, sum);
+			int32_t result = _mm_cvtsi128_si32(_mm_packus_epi16(sum, sum));
+			memcpy(dst_row + x * 4, &result, sizeof(result));
+#else
+			int32_t acc[4] = {0};
+			for (int k = 0; k < contrib->count; k++, pixel += 4) {
+				acc[0] += weights[k] * pixel[0];
+				acc[1] += weights[k] * pixel[1];
+				acc[2] += weights[k] * pixel[2];
+				acc[3] += weights[k] * pixel[3];
+			}
+			for (int c = 0; c < 4; c++) {
+				dst_row[x * 4 + c] = clamp_pixel(acc[c]);
+			}
+#endif
+		}
+	}
+}
+
+/* Bytes 'from' to 'to' of one output row, whole pixels */
+static void vertical_scalar(const unsigned char *const *rows, const int16_t *weights, int count,
+							size_t from, size_t to, unsigned char *dst_row, bool swap,
+																	int32_t *acc) {
+	memset(acc + from, 0, (to - from) * sizeof(int32_t));
+	for (int k = 0; k < count; k++) {
+		int32_t weight = weights[k];
+		for (size_t i = from; i < to; i++) {
+			acc[i] += weight * rows[k][i];
+		}
+	}
+	for (size_t i = from; i < to; i += 4) {
+		dst_row[i] = clamp_pixel(acc[swap ? i + 2 : i]);
+		dst_row[i + 1] = clamp_pixel(acc[i + 1]);
+		dst_row[i + 2] = clamp_pixel(acc[swap ? i : i + 2]);
+		dst_row[i + 3] = clamp_pixel(acc[i + 3]);
+	}
+}
+
+#if defined(__AVX2__)
+#define VERTICAL_CHUNK 32
+/* Weighted sum of the same 32 bytes of two rows */
+static inline void vertical_madd(__m256i sum[4], __m256i a, __m256i b, __m256i weights) {
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i a_lo = _mm256_unpacklo_epi8(a, zero), a_hi = _mm256_unpackhi_epi8(a, zero);
+	__m256i b_lo = _mm256_unpacklo_epi8(b, zero), b_hi = _mm256_unpackhi_epi8(b, zero);
+	sum[0] = _mm256_add_epi32(sum[0], _mm256_madd_epi16(_mm256_unpacklo_epi16(a_lo, b_lo), weights));
+	sum[1] = _mm256_add_epi32(sum[1], _mm256_madd_epi16(_mm256_unpackhi_epi16(a_lo, b_lo), weights));
+	sum[2] = _mm256_add_epi32(sum[2], _mm256_madd_epi16(_mm256_unpacklo_epi16(a_hi, b_hi), weights));
+	sum[3] = _mm256_add_epi32(sum[3], _mm256_madd_epi16(_mm256_unpackhi_epi16(a_hi, b_hi), weights));
+}
+
+/* Unpacking and packing both work within 128 bit lanes, so the bytes come out
+ * in their original order.
+ */
+static void vertical_chunk(const unsigned char *const *rows, const int16_t *weights, int count,
+											size_t offset, unsigned char *dst, bool swap) {
+	const __m256i round = _mm256_set1_epi32(WEIGHT_ONE / 2);
+	__m256i sum[4] = { _mm256_setzero_si256(), _mm256_setzero_si256(),
+						_mm256_setzero_si256(), _mm256_setzero_si256() };
+	int k = 0;
+	for (; k + 1 < count; k += 2) {
+		vertical_madd(sum, _mm256_loadu_si256((const __m256i *)(rows[k] + offset)),
+							_mm256_loadu_si256((const __m256i *)(rows[k + 1] + offset)),
+							_mm256_set1_epi32(weight_pair(weights[k], weights[k + 1])));
+	}
+	if (k < count) {
+		vertical_madd(sum, _mm256_loadu_si256((const __m256i *)(rows[k] + offset)),
+					_mm256_setzero_si256(), _mm256_set1_epi32(weight_pair(weights[k], 0)));
+	}
+	for (int j = 0; j < 4; j++) {
+		sum[j] = _mm256_srai_epi32(_mm256_add_epi32(sum[j], round), WEIGHT_BITS);
+	}
+	__m256i lo = _mm256_packs_epi32(sum[0], sum[1]);
+	__m256i hi = _mm256_packs_epi32(sum[2], sum[3]);
+	if (swap) {
+		lo = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo, _MM_SHUFFLE(3, 0, 1, 2)),
+																_MM_SHUFFLE(3, 0, 1, 2));
+		hi = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi, _MM_SHUFFLE(3, 0, 1, 2)),
+																_MM_SHUFFLE(3, 0, 1, 2));
+	}
+	_mm256_storeu_si256((__m256i *)(dst + offset), _mm256_packus_epi16(lo, hi));
+}
+#elif defined(__SSE2__)
+#define VERTICAL_CHUNK 16
+/* Weighted sum of the same 16 bytes of two rows */
+static inline void vertical_madd(__m128i sum[4], __m128i a, __m128i b, __m128i weights) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a_lo = _mm_unpacklo_epi8(a, zero), a_hi = _mm_unpackhi_epi8(a, zero);
+	__m128i b_lo = _mm_unpacklo_epi8(b, zero), b_hi = _mm_unpackhi_epi8(b, zero);
+	sum[0] = _mm_add_epi32(sum[0], _mm_madd_epi16(_mm_unpacklo_epi16(a_lo, b_lo), weights));
+	sum[1] = _mm_add_epi32(sum[1], _mm_madd_epi16(_mm_unpackhi_epi16(a_lo, b_lo), weights));
+	sum[2] = _mm_add_epi32(sum[2], _mm_madd_epi16(_mm_unpacklo_epi16(a_hi, b_hi), weights));
+	sum[3] = _mm_add_epi32(sum[3], _mm_madd_epi16(_mm_unpackhi_epi16(a_hi, b_hi), weights));
+}
+
+static void vertical_chunk(const unsigned char *const *rows, const int16_t *weights, int count,
+											size_t offset, unsigned char *dst, bool swap) {
+	const __m128i round = _mm_set1_epi32(WEIGHT_ONE / 2);
+	__m128i sum[4] = { _mm_setzero_si128(), _mm_setzero_si128(),
+						_mm_setzero_si128(), _mm_setzero_si128() };
+	int k = 0;
+	for (; k + 1 < count; k += 2) {
+		vertical_madd(sum, _mm_loadu_si128((const __m128i *)(rows[k] + offset)),
+							_mm_loadu_si128((const __m128i *)(rows[k + 1] + offset)),
+							_mm_set1_epi32(weight_pair(weights[k], weights[k + 1])));
+	}
+	if (k < count) {
+		vertical_madd(sum, _mm_loadu_si128((const __m128i *)(rows[k] + offset)),
+							_mm_setzero_si128(), _mm_set1_epi32(weight_pair(weights[k], 0)));
+	}
+	for (int j = 0; j < 4; j++) {
+		sum[j] = _mm_srai_epi32(_mm_add_epi32(sum[j], round), WEIGHT_BITS);
+	}
+	__m128i lo = _mm_packs_epi32(sum[0], sum[1]);
+	__m128i hi = _mm_packs_epi32(sum[2], sum[3]);
+	if (swap) {
+		lo = SWAP_RB_EPI16(lo);
+		hi = SWAP_RB_EPI16(hi);
+	}
+	_mm_storeu_si128((__m128i *)(dst + offset), _mm_packus_epi16(lo, hi));
+}
+#endif
+
+/* Row by row, so both images are read and written sequentially. 'rows' has
+ * room for filter->max_count pointers, 'acc' for one output row.
+ */
+static void resize_vertical(const struct imagescale_image *src,
+						const struct imagescale_image *dst, const struct filter *filter,
+						bool swap, const unsigned char **rows, int32_t *acc) {
+	size_t row_size = (size_t)dst->width * 4;
+	for (int y = 0; y < dst->height; y++) {
+		const struct contrib *contrib = &filter->contribs[y];
+		const int16_t *weights = &filter->weights[(size_t)y * filter->max_count];
+		unsigned char *dst_row = dst->pixels + (size_t)y * dst->stride;
+		for (int k = 0; k < contrib->count; k++) {
+			rows[k] = src->pixels + (size_t)(contrib->start + k) * src->stride;
+		}
+		size_t done = 0;
+#if defined(VERTICAL_CHUNK)
+		for (; done + VERTICAL_CHUNK <= row_size; done += VERTICAL_CHUNK) {
+			vertical_chunk(rows, weights, contrib->count, done, dst_row, swap);
+		}
+#endif
+		// The rest of the row is narrower than a register
+		if (done < row_size) {
+			vertical_scalar(rows, weights, contrib->count, done, row_size, dst_row, swap, acc);
+		}
+	}
+}
+
+bool imagescale_resize(const struct imagescale_image *src, const struct imagescale_image *dst,
+													enum imagescale_format format) {
+	if (src->width <= 0 || src->height <= 0 || dst->width <= 0 || dst->height <= 0) {
+		return false;
+	}
+	struct filter horizontal, vertical;
+	if (!filter_create(&horizontal, src->width, dst->width)) {
+		return false;
+	}
+	if (!filter_create(&vertical, src->height, dst->height)) {
+		filter_destroy(&horizontal);
+		return false;
+	}
+	// Width is resampled first, the temporary image has the source's height
+	struct imagescale_image tmp = {
+		.width = dst->width,
+		.height = src->height,
+		.stride = dst->width * 4,
+	};
+	tmp.pixels = malloc((size_t)tmp.stride * tmp.height);
+	int32_t *acc = malloc((size_t)dst->width * 4 * sizeof(int32_t));
+	const unsigned char **rows = malloc(vertical.max_count * sizeof(*rows));
+	bool done = tmp.pixels && acc && rows;
+	if (done) {
+		resize_horizontal(src, &tmp, &horizontal);
+		resize_vertical(&tmp, dst, &vertical, format == IMAGESCALE_BGRA, rows, acc);
+	}
+	free(rows);
+	free(acc);
+	free(tmp.pixels);
+	filter_destroy(&vertical);
+	filter_destroy(&horizontal);
+	return done;
+}
+
+bool imagescale_mode_from_name(const char *name, enum imagescale_mode *mode) {
+	static const struct {
+		const char *name;
+		enum imagescale_mode mode;
+	} modes[] = {
+		{ "fill", IMAGESCALE_FILL },
+		{ "fit", IMAGESCALE_FIT },
+		{ "tile", IMAGESCALE_TILE },
+		{ "stretch", IMAGESCALE_STRETCH },
+	};
+	for (size_t i = 0; name && i < sizeof(modes) / sizeof(modes[0]); i++) {
+		if (strcmp(name, modes[i].name) == 0) {
+			*mode = modes[i].mode;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Copies 'count' RGBA pixels, converting them to 'format' */
+static void convert_row(unsigned char *dst, const unsigned char *src, size_t count,
+													enum imagescale_format format) {
+	if (format == IMAGESCALE_RGBA) {
+		memcpy(dst, src, count * 4);
+		return;
+	}
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 4 <= count; i += 4) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i * 4));
+		__m128i lo = SWAP_RB_EPI16(_mm_unpacklo_epi8(v, zero));
+		__m128i hi = SWAP_RB_EPI16(_mm_unpackhi_epi8(v, zero));
+		_mm_storeu_si128((__m128i *)(dst + i * 4), _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for (; i < count; i++) {
+		dst[i * 4] = src[i * 4 + 2];
+		dst[i * 4 + 1] = src[i * 4 + 1];
+		dst[i * 4 + 2] = src[i * 4];
+		dst[i * 4 + 3] = src[i * 4 + 3];
+	}
+}
+
+/* Part of 'image' starting at x, y, sharing its pixels */
+static struct imagescale_image sub_image(const struct imagescale_image *image, int x, int y,
+															int width, int height) {
+	struct imagescale_image sub = {
+		.pixels = image->pixels + (size_t)y * image->stride + (size_t)x * 4,
+		.width = width,
+		.height = height,
+		.stride = image->stride,
+	};
+	return sub;
+}
+
+bool imagescale_render(const struct imagescale_image *src, int width, int height,
+				enum imagescale_mode mode, enum imagescale_format format,
+						const unsigned char fill[4], struct imagescale_image *out) {
+	if (!src || !src->pixels || src->width <= 0 || src->height <= 0 ||
+										width <= 0 || height <= 0) {
+		return false;
+	}
+	out->width = width;
+	out->height = height;
+	out->stride = width * 4;
+	out->pixels = malloc((size_t)out->stride * height);
+	if (!out->pixels) {
+		return false;
+	}
+
+	bool done = true;
+	switch (mode) {
+	case IMAGESCALE_FILL: {
+		// Scale to cover, crop what exceeds the output around the center
+		double scale = fmax((double)width / src->width, (double)height / src->height);
+		int crop_width = (int)fmax(1, fmin(src->width, lround(width / scale)));
+		int crop_height = (int)fmax(1, fmin(src->height, lround(height / scale)));
+		struct imagescale_image crop = sub_image(src, (src->width - crop_width) / 2,
+							(src->height - crop_height) / 2, crop_width, crop_height);
+		done = imagescale_resize(&crop, out, format);
+		break;
+	}
+	case IMAGESCALE_FIT: {
+		double scale = fmin((double)width / src->width, (double)height / src->height);
+		int fit_width = (int)fmax(1, fmin(width, lround(src->width * scale)));
+		int fit_height = (int)fmax(1, fmin(height, lround(src->height * scale)));
+		unsigned char color[4];
+		convert_row(color, fill, 1, format);
+		for (int i = 0; i < width * height; i++) {
+			memcpy(out->pixels + (size_t)i * 4, color, 4);
+		}
+		struct imagescale_image area = sub_image(out, (width - fit_width) / 2,
+								(height - fit_height) / 2, fit_width, fit_height);
+		done = imagescale_resize(src, &area, format);
+		break;
+	}
+	case IMAGESCALE_TILE:
+		for (int y = 0; y < height; y++) {
+			const unsigned char *src_row = src->pixels + (size_t)(y % src->height) * src->stride;
+			unsigned char *dst_row = out->pixels + (size_t)y * out->stride;
+			for (int x = 0; x < width; x += src->width) {
+				int count = width - x < src->width ? width - x : src->width;
+				convert_row(dst_row + (size_t)x * 4, src_row, count, format);
+			}
+		}
+		break;
+	case IMAGESCALE_STRETCH:
+		done = imagescale_resize(src, out, format);
+		break;
+	}
+	if (!done) {
+		free(out->pixels);
+		out->pixels = NULL;
+	}
+	return done;
+}
+
+const char *imagescale_kernel(void) {
+#if defined(__AVX2__)
+	return "avx2";
+#elif defined(__SSE2__)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef IMAGESCALE_H_
+#define IMAGESCALE_H_
+
+#include <stdbool.h>
+
+/* 4 bytes per pixel, sources are always RGBA as decoded by stb_image */
+struct imagescale_image {
+	unsigned char *pixels;
+	int width;
+	int height;
+	int stride;
+};
+
+enum imagescale_mode {
+	IMAGESCALE_FILL,	// cover the whole output, cropping the image
+	IMAGESCALE_FIT,		// show the whole image, bars around it
+	IMAGESCALE_TILE,	// repeat the image at its native size
+	IMAGESCALE_STRETCH,	// ignore the aspect ratio
+};
+
+/* Byte order of the scaled image, the conversion is done while storing it */
+enum imagescale_format {
+	IMAGESCALE_RGBA,	// DRM_FORMAT_ABGR8888/XBGR8888
+	IMAGESCALE_BGRA,	// DRM_FORMAT_ARGB8888/XRGB8888
+};
+
+/* 'fill', 'fit', 'tile' or 'stretch', false if the name is unknown */
+bool imagescale_mode_from_name(const char *name, enum imagescale_mode *mode);
+
+/* Resamples the whole of 'src' into the whole of 'dst', both already allocated.
+ * False if either is empty or the filters could not be allocated.
+ */
+bool imagescale_resize(const struct imagescale_image *src, const struct imagescale_image *dst,
+													enum imagescale_format format);
+
+/* Places 'src' on a new width x height image according to 'mode', the rest is
+ * painted with the RGBA color 'fill'. The caller frees out->pixels with free().
+ */
+bool imagescale_render(const struct imagescale_image *src, int width, int height,
+				enum imagescale_mode mode, enum imagescale_format format,
+						const unsigned char fill[4], struct imagescale_image *out);
+
+/* "avx2", "sse2" or "scalar", the kernels this build was compiled with */
+const char *imagescale_kernel(void);
+
+#endif
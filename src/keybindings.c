@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Keyboard shortcuts dispatch table.
+ * All the binding_NAME / command_NAME pairs of woodland.ini are compiled once
+ * into a hash table keyed by (modifier mask, keysym), so a key press costs a
+ * single lookup without touching the config file or allocating memory.
+ * A binding may combine several modifiers, e.g:
+ *	binding_term = WLR_MODIFIER_CTRL WLR_MODIFIER_ALT XKB_KEY_t
+ *	command_term = foot
+ * The default compositor shortcuts (Super+Esc, Super+x, Alt+Tab) live in the
+ * same table, a user binding with the same keys replaces them. Commands are
+ * split and resolved through the command cache when the table is built.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <wlr/util/log.h>
+#include <wlr/types/wlr_keyboard.h>
+#include "keybindings.h"
+
+#define KEYBINDING_MODIFIERS_MASK (WLR_MODIFIER_SHIFT | WLR_MODIFIER_CTRL | \
+									WLR_MODIFIER_ALT | WLR_MODIFIER_LOGO)
+
+static const struct {
+	const char *name;
+	uint32_t modifier;
+} modifier_names[] = {
+	{ "WLR_MODIFIER_SHIFT", WLR_MODIFIER_SHIFT },
+	{ "WLR_MODIFIER_CTRL", WLR_MODIFIER_CTRL },
+	{ "WLR_MODIFIER_ALT", WLR_MODIFIER_ALT },
+	{ "WLR_MODIFIER_LOGO", WLR_MODIFIER_LOGO },
+	{ "Shift", WLR_MODIFIER_SHIFT },
+	{ "Ctrl", WLR_MODIFIER_CTRL },
+	{ "Alt", WLR_MODIFIER_ALT },
+	{ "Super", WLR_MODIFIER_LOGO },
+	{ "Logo", WLR_MODIFIER_LOGO },
+};
+
+static size_t hash_binding(uint32_t modifiers, xkb_keysym_t keysym) {
+	uint64_t key = ((uint64_t)modifiers << 32) | keysym;
+	// splitmix64 finalizer
+	key ^= key >> 30;
+	key *= 0xbf58476d1ce4e5b9ULL;
+	key ^= key >> 27;
+	key *= 0x94d049bb133111ebULL;
+	key ^= key >> 31;
+	return (size_t)key;
+}
+
+static struct keybinding *find_slot(const struct keybindings *bindings, uint32_t modifiers,
+																	xkb_keysym_t keysym) {
+	size_t mask = bindings->num_slots - 1;
+	for (size_t i = hash_binding(modifiers, keysym) & mask;; i = (i + 1) & mask) {
+		struct keybinding *slot = &bindings->slots[i];
+		if (slot->action == KEYBINDING_ACTION_NONE ||
+			(slot->modifiers == modifiers && slot->keysym == keysym)) {
+			return slot;
+		}
+	}
+}
+
+static void add_binding(struct keybindings *bindings, uint32_t modifiers, xkb_keysym_t keysym,
+							enum keybinding_action action, struct cmdcache_entry *command) {
+	struct keybinding *slot = find_slot(bindings, modifiers, keysym);
+	if (slot->action == KEYBINDING_ACTION_NONE) {
+		bindings->count++;
+	}
+	slot->modifiers = modifiers;
+	slot->keysym = keysym;
+	slot->action = action;
+	slot->command = command;
+}
+
+/* Parses 'WLR_MODIFIER_CTRL WLR_MODIFIER_ALT XKB_KEY_t' (also 'Ctrl+Alt+t'),
+ * the last token is the key, everything before it are modifiers.
+ */
+static bool parse_binding(const char *value, uint32_t *modifiers, xkb_keysym_t *keysym) {
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer), "%s", value);
+
+	char *tokens[16];
+	int num_tokens = 0;
+	char *saveptr = NULL;
+	for (char *token = strtok_r(buffer, " \t+", &saveptr); token && num_tokens < 16;
+										token = strtok_r(NULL, " \t+", &saveptr)) {
+		tokens[num_tokens++] = token;
+	}
+	if (num_tokens == 0) {
+		return false;
+	}
+
+	*modifiers = 0;
+	for (int i = 0; i < num_tokens - 1; i++) {
+		bool found = false;
+		for (size_t j = 0; j < sizeof(modifier_names) / sizeof(modifier_names[0]); j++) {
+			if (strcasecmp(tokens[i], modifier_names[j].name) == 0) {
+				*modifiers |= modifier_names[j].modifier;
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			wlr_log(WLR_ERROR, "Unknown modifier '%s' in keybinding '%s'", tokens[i], value);
+			return false;
+		}
+	}
+
+	// Key names are written as in xkbcommon-keysyms.h, e.g. XKB_KEY_f
+	const char *keyname = tokens[num_tokens - 1];
+	if (strncmp(keyname, "XKB_KEY_", 8) == 0) {
+		keyname += 8;
+	}
+	*keysym = xkb_keysym_from_name(keyname, XKB_KEYSYM_NO_FLAGS);
+	if (*keysym == XKB_KEY_NoSymbol) {
+		*keysym = xkb_keysym_from_name(keyname, XKB_KEYSYM_CASE_INSENSITIVE);
+	}
+	if (*keysym == XKB_KEY_NoSymbol) {
+		wlr_log(WLR_ERROR, "Unknown key '%s' in keybinding '%s'", keyname, value);
+		return false;
+	}
+	*keysym = xkb_keysym_to_lower(*keysym);
+	if (*modifiers == 0) {
+		wlr_log(WLR_ERROR, "Keybinding '%s' needs at least one modifier", value);
+		return false;
+	}
+	return true;
+}
+
+struct keybindings *keybindings_create(const struct config_store *conf,
+												struct cmdcache *commands) {
+	struct keybindings *bindings = calloc(1, sizeof(struct keybindings));
+	if (!bindings) {
+		return NULL;
+	}
+
+	// Default shortcuts plus every binding_ entry, keep the load factor below 0.5
+	size_t expected = 3;
+	for (size_t i = 0; conf && i < conf->num_entries; i++) {
+		if (strncmp(conf->entries[i].key, "binding_", 8) == 0) {
+			expected++;
+		}
+	}
+	bindings->num_slots = 16;
+	while (bindings->num_slots < expected * 2) {
+		bindings->num_slots *= 2;
+	}
+	bindings->slots = calloc(bindings->num_slots, sizeof(struct keybinding));
+	if (!bindings->slots) {
+		free(bindings);
+		return NULL;
+	}
+
+	add_binding(bindings, WLR_MODIFIER_LOGO, XKB_KEY_Escape, KEYBINDING_ACTION_TERMINATE, NULL);
+	add_binding(bindings, WLR_MODIFIER_LOGO, XKB_KEY_x, KEYBINDING_ACTION_CLOSE_VIEW, NULL);
+	add_binding(bindings, WLR_MODIFIER_ALT, XKB_KEY_Tab, KEYBINDING_ACTION_NEXT_VIEW, NULL);
+
+	for (size_t i = 0; conf && i < conf->num_entries; i++) {
+		const struct config_entry *entry = &conf->entries[i];
+		if (strncmp(entry->key, "binding_", 8) != 0) {
+			continue;
+		}
+		// binding_NAME is paired with command_NAME
+		char command_key[256];
+		snprintf(command_key, sizeof(command_key), "command_%s", entry->key + 8);
+		const char *command = config_store_get_string(conf, command_key, NULL);
+		if (!command || command[0] == '\0') {
+			wlr_log(WLR_ERROR, "No %s found for %s", command_key, entry->key);
+			continue;
+		}
+		uint32_t modifiers;
+		xkb_keysym_t keysym;
+		if (!parse_binding(entry->value, &modifiers, &keysym)) {
+			continue;
+		}
+		struct cmdcache_entry *cached = cmdcache_add(commands, command);
+		if (!cached) {
+			continue;
+		}
+		add_binding(bindings, modifiers, keysym, KEYBINDING_ACTION_COMMAND, cached);
+	}
+	wlr_log(WLR_INFO, "Loaded %zu keybindings", bindings->count);
+	return bindings;
+}
+
+void keybindings_destroy(struct keybindings *bindings) {
+	if (!bindings) {
+		return;
+	}
+	free(bindings->slots);
+	free(bindings);
+}
+
+const struct keybinding *keybindings_lookup(const struct keybindings *bindings,
+											uint32_t modifiers, xkb_keysym_t keysym) {
+	if (!bindings) {
+		return NULL;
+	}
+	// Caps Lock, Num Lock and friends must not prevent a shortcut from firing
+	modifiers &= KEYBINDING_MODIFIERS_MASK;
+	if (modifiers == 0) {
+		return NULL;
+	}
+	struct keybinding *slot = find_slot(bindings, modifiers, xkb_keysym_to_lower(keysym));
+	return slot->action == KEYBINDING_ACTION_NONE ? NULL : slot;
+}
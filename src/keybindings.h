@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef KEYBINDINGS_H_
+#define KEYBINDINGS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <xkbcommon/xkbcommon.h>
+#include "cmdcache.h"
+#include "configstore.h"
+
+enum keybinding_action {
+	KEYBINDING_ACTION_NONE,
+	KEYBINDING_ACTION_COMMAND,		// run 'command'
+	KEYBINDING_ACTION_TERMINATE,	// log out from the compositor
+	KEYBINDING_ACTION_CLOSE_VIEW,	// close the current window
+	KEYBINDING_ACTION_NEXT_VIEW,	// cycle to the next window
+};
+
+struct keybinding {
+	uint32_t modifiers;				// WLR_MODIFIER_* mask, only Shift/Ctrl/Alt/Logo
+	xkb_keysym_t keysym;			// always lower case
+	enum keybinding_action action;
+	struct cmdcache_entry *command;	// owned by the command cache
+};
+
+/* Open addressing table keyed by (modifier mask, keysym), built once at startup */
+struct keybindings {
+	struct keybinding *slots;
+	size_t num_slots;
+	size_t count;
+};
+
+struct keybindings *keybindings_create(const struct config_store *conf,
+												struct cmdcache *commands);
+void keybindings_destroy(struct keybindings *bindings);
+const struct keybinding *keybindings_lookup(const struct keybindings *bindings,
+											uint32_t modifiers, xkb_keysym_t keysym);
+
+#endif
@@ -0,0 +1,297 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* End to end input latency, per input device and kind of event.
+ * An input event sent to a surface becomes a sample that follows it to the
+ * screen: the next commit of that surface, the output commit of the first
+ * frame showing the surface after it, and the presentation of that output
+ * commit, matched by its commit sequence number. Each step is recorded from
+ * the input event time, so the histograms tell how long a key press or a click
+ * took to show up and which part of the way took it.
+ * Only the oldest event in flight per device and surface is followed, later
+ * ones before the surface commits are counted as coalesced.
+ */
+
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/util/log.h>
+#include <wlr/types/wlr_output.h>
+#include "latency.h"
+
+#define LATENCY_TIMEOUT_MS 1000		// samples not shown by then are dropped
+#define LATENCY_MAX_AGE_MS 10000	// older event times come from another clock
+#define LATENCY_MAX_SAMPLES 1024
+
+static const char *kind_names[] = {
+	[LATENCY_KEY] = "key",
+	[LATENCY_BUTTON] = "button",
+	[LATENCY_MOTION] = "motion",
+};
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* libinput stamps events in milliseconds of CLOCK_MONOTONIC, the lower 32 bits
+ * of it. Virtual devices may use any clock, those are measured from now.
+ */
+static uint64_t event_time_ns(uint32_t time_msec, uint64_t now) {
+	uint32_t age_ms = (uint32_t)(now / 1000000) - time_msec;
+	if (age_ms > LATENCY_MAX_AGE_MS) {
+		return now;
+	}
+	return now - (uint64_t)age_ms * 1000000;
+}
+
+static struct latency_stats *stats_get(struct latency_tracker *tracker, const char *device,
+															enum latency_kind kind) {
+	for (size_t i = 0; i < tracker->num_stats; i++) {
+		struct latency_stats *stats = tracker->stats[i];
+		if (stats->kind == kind && strcmp(stats->device, device) == 0) {
+			return stats;
+		}
+	}
+	if (tracker->num_stats == tracker->cap_stats) {
+		size_t cap = tracker->cap_stats ? tracker->cap_stats * 2 : 8;
+		struct latency_stats **array = realloc(tracker->stats, cap * sizeof(*array));
+		if (!array) {
+			return NULL;
+		}
+		tracker->stats = array;
+		tracker->cap_stats = cap;
+	}
+	struct latency_stats *stats = calloc(1, sizeof(struct latency_stats));
+	if (!stats) {
+		return NULL;
+	}
+	stats->device = strdup(device);
+	if (!stats->device) {
+		free(stats);
+		return NULL;
+	}
+	stats->kind = kind;
+	tracker->stats[tracker->num_stats++] = stats;
+	return stats;
+}
+
+static void remove_sample(struct latency_tracker *tracker, size_t index) {
+	tracker->samples[index] = tracker->samples[--tracker->num_samples];
+}
+
+static void expire_samples(struct latency_tracker *tracker, uint64_t now) {
+	for (size_t i = 0; i < tracker->num_samples;) {
+		struct latency_sample *sample = &tracker->samples[i];
+		if (now - sample->event_ns > (uint64_t)LATENCY_TIMEOUT_MS * 1000000) {
+			sample->stats->dropped++;
+			remove_sample(tracker, i);
+			continue;
+		}
+		i++;
+	}
+}
+
+static void finish_sample(struct latency_sample *sample, const struct latency_present *present) {
+	if (!present->presented) {
+		sample->stats->dropped++;
+		return;
+	}
+	uint64_t when = present->when_ns > sample->event_ns ? present->when_ns : sample->event_ns;
+	histogram_add(&sample->stats->present, when - sample->event_ns);
+}
+
+struct latency_tracker *latency_tracker_create(void) {
+	return calloc(1, sizeof(struct latency_tracker));
+}
+
+void latency_tracker_destroy(struct latency_tracker *tracker) {
+	if (!tracker) {
+		return;
+	}
+	for (size_t i = 0; i < tracker->num_stats; i++) {
+		free(tracker->stats[i]->device);
+		free(tracker->stats[i]);
+	}
+	free(tracker->stats);
+	free(tracker->samples);
+	free(tracker->presents);
+	free(tracker);
+}
+
+void latency_input(struct latency_tracker *tracker, const char *device, enum latency_kind kind,
+										struct wlr_surface *surface, uint32_t time_msec) {
+	if (!surface) {
+		return;
+	}
+	struct latency_stats *stats = stats_get(tracker, device ? device : "unknown", kind);
+	if (!stats) {
+		wlr_log(WLR_ERROR, "Error: Failed to allocate memory in 'latency_input'!");
+		return;
+	}
+	uint64_t now = now_ns();
+	uint64_t event = event_time_ns(time_msec, now);
+	histogram_add(&stats->handled, now - event);
+	for (size_t i = 0; i < tracker->num_samples; i++) {
+		struct latency_sample *sample = &tracker->samples[i];
+		if (sample->stats == stats && sample->surface == surface &&
+										sample->stage == LATENCY_WAIT_COMMIT) {
+			stats->coalesced++;
+			return;
+		}
+	}
+	if (tracker->num_samples == tracker->cap_samples) {
+		expire_samples(tracker, now);
+	}
+	if (tracker->num_samples == tracker->cap_samples) {
+		size_t cap = tracker->cap_samples ? tracker->cap_samples * 2 : 16;
+		struct latency_sample *samples = cap <= LATENCY_MAX_SAMPLES ?
+					realloc(tracker->samples, cap * sizeof(struct latency_sample)) : NULL;
+		if (!samples) {
+			stats->dropped++;
+			return;
+		}
+		tracker->samples = samples;
+		tracker->cap_samples = cap;
+	}
+	tracker->samples[tracker->num_samples++] = (struct latency_sample){
+		.stats = stats,
+		.surface = surface,
+		.stage = LATENCY_WAIT_COMMIT,
+		.event_ns = event,
+	};
+}
+
+void latency_surface_commit(struct latency_tracker *tracker, struct wlr_surface *surface) {
+	if (tracker->num_samples == 0) {
+		return;
+	}
+	uint64_t now = now_ns();
+	for (size_t i = 0; i < tracker->num_samples; i++) {
+		struct latency_sample *sample = &tracker->samples[i];
+		if (sample->surface == surface && sample->stage == LATENCY_WAIT_COMMIT) {
+			sample->stage = LATENCY_WAIT_OUTPUT;
+			sample->commit_ns = now;
+			histogram_add(&sample->stats->commit, now - sample->event_ns);
+		}
+	}
+}
+
+void latency_surface_destroy(struct latency_tracker *tracker, struct wlr_surface *surface) {
+	for (size_t i = 0; i < tracker->num_samples;) {
+		if (tracker->samples[i].surface == surface) {
+			remove_sample(tracker, i);
+			continue;
+		}
+		i++;
+	}
+}
+
+static struct latency_present *find_present(struct latency_tracker *tracker,
+												struct wlr_output *output) {
+	for (size_t i = 0; i < tracker->num_presents; i++) {
+		if (tracker->presents[i].output == output) {
+			return &tracker->presents[i];
+		}
+	}
+	return NULL;
+}
+
+void latency_output_commit(struct latency_tracker *tracker, struct wlr_output *output,
+										latency_shown_func_t shown, void *data) {
+	if (tracker->num_samples == 0) {
+		return;
+	}
+	uint64_t now = now_ns();
+	expire_samples(tracker, now);
+	// Some backends present the frame before the commit event is emitted
+	const struct latency_present *present = find_present(tracker, output);
+	if (present && present->commit_seq != output->commit_seq) {
+		present = NULL;
+	}
+	for (size_t i = 0; i < tracker->num_samples;) {
+		struct latency_sample *sample = &tracker->samples[i];
+		if (sample->stage != LATENCY_WAIT_OUTPUT || !shown(sample->surface, data)) {
+			i++;
+			continue;
+		}
+		sample->stage = LATENCY_WAIT_PRESENT;
+		sample->output_ns = now;
+		sample->output = output;
+		sample->commit_seq = output->commit_seq;
+		histogram_add(&sample->stats->output, now - sample->event_ns);
+		if (present) {
+			finish_sample(sample, present);
+			remove_sample(tracker, i);
+			continue;
+		}
+		i++;
+	}
+}
+
+void latency_output_present(struct latency_tracker *tracker,
+										struct wlr_output_event_present *event) {
+	struct latency_present *present = find_present(tracker, event->output);
+	if (!present) {
+		if (tracker->num_presents == tracker->cap_presents) {
+			size_t cap = tracker->cap_presents ? tracker->cap_presents * 2 : 4;
+			struct latency_present *presents = realloc(tracker->presents,
+												cap * sizeof(struct latency_present));
+			if (!presents) {
+				return;
+			}
+			tracker->presents = presents;
+			tracker->cap_presents = cap;
+		}
+		present = &tracker->presents[tracker->num_presents++];
+		present->output = event->output;
+	}
+	present->commit_seq = event->commit_seq;
+	present->presented = event->presented;
+	present->when_ns = event->when ?
+		(uint64_t)event->when->tv_sec * 1000000000 + event->when->tv_nsec : now_ns();
+
+	for (size_t i = 0; i < tracker->num_samples;) {
+		struct latency_sample *sample = &tracker->samples[i];
+		if (sample->stage == LATENCY_WAIT_PRESENT && sample->output == event->output &&
+											sample->commit_seq == event->commit_seq) {
+			finish_sample(sample, present);
+			remove_sample(tracker, i);
+			continue;
+		}
+		i++;
+	}
+}
+
+void latency_output_destroy(struct latency_tracker *tracker, struct wlr_output *output) {
+	for (size_t i = 0; i < tracker->num_samples;) {
+		if (tracker->samples[i].output == output) {
+			tracker->samples[i].stats->dropped++;
+			remove_sample(tracker, i);
+			continue;
+		}
+		i++;
+	}
+	struct latency_present *present = find_present(tracker, output);
+	if (present) {
+		*present = tracker->presents[--tracker->num_presents];
+	}
+}
+
+void latency_dump(const struct latency_tracker *tracker) {
+	char buffer[160];
+	for (size_t i = 0; i < tracker->num_stats; i++) {
+		const struct latency_stats *stats = tracker->stats[i];
+		const char *kind = kind_names[stats->kind];
+		wlr_log(WLR_INFO, "Latency %s %s: %lu coalesced, %lu dropped", stats->device, kind,
+											stats->coalesced, stats->dropped);
+		histogram_format(&stats->handled, buffer, sizeof(buffer));
+		wlr_log(WLR_INFO, "Latency %s %s to handled: %s", stats->device, kind, buffer);
+		histogram_format(&stats->commit, buffer, sizeof(buffer));
+		wlr_log(WLR_INFO, "Latency %s %s to surface commit: %s", stats->device, kind, buffer);
+		histogram_format(&stats->output, buffer, sizeof(buffer));
+		wlr_log(WLR_INFO, "Latency %s %s to output commit: %s", stats->device, kind, buffer);
+		histogram_format(&stats->present, buffer, sizeof(buffer));
+		wlr_log(WLR_INFO, "Latency %s %s to presentation: %s", stats->device, kind, buffer);
+	}
+}
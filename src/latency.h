@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "histogram.h"
+
+struct wlr_output;
+struct wlr_surface;
+struct wlr_output_event_present;
+
+enum latency_kind {
+	LATENCY_KEY,
+	LATENCY_BUTTON,
+	LATENCY_MOTION,
+};
+
+/* Latencies of one kind of event of one input device, from the event time */
+struct latency_stats {
+	char *device;
+	enum latency_kind kind;
+	struct histogram handled;		// woodland handled the event
+	struct histogram commit;		// the surface it went to committed
+	struct histogram output;		// an output committed a frame showing that commit
+	struct histogram present;		// that frame was presented
+	unsigned long coalesced;		// events while an earlier one to the surface was in flight
+	unsigned long dropped;			// not shown within LATENCY_TIMEOUT_MS
+};
+
+enum latency_stage {
+	LATENCY_WAIT_COMMIT,
+	LATENCY_WAIT_OUTPUT,
+	LATENCY_WAIT_PRESENT,
+};
+
+/* One input event on its way to the screen */
+struct latency_sample {
+	struct latency_stats *stats;
+	struct wlr_surface *surface;
+	enum latency_stage stage;
+	uint64_t event_ns;				// CLOCK_MONOTONIC
+	uint64_t commit_ns;
+	uint64_t output_ns;
+	struct wlr_output *output;		// set from LATENCY_WAIT_PRESENT
+	uint32_t commit_seq;
+};
+
+/* Last presentation of an output, backends may send it before the commit event */
+struct latency_present {
+	struct wlr_output *output;
+	uint32_t commit_seq;
+	uint64_t when_ns;
+	bool presented;
+};
+
+struct latency_tracker {
+	struct latency_stats **stats;
+	size_t num_stats;
+	size_t cap_stats;
+	struct latency_sample *samples;
+	size_t num_samples;
+	size_t cap_samples;
+	struct latency_present *presents;
+	size_t num_presents;
+	size_t cap_presents;
+};
+
+/* Whether the frame just committed on an output shows the surface */
+typedef bool (*latency_shown_func_t)(struct wlr_surface *surface, void *data);
+
+struct latency_tracker *latency_tracker_create(void);
+void latency_tracker_destroy(struct latency_tracker *tracker);
+
+/* An event of 'device' with the input time 'time_msec' was sent to 'surface' */
+void latency_input(struct latency_tracker *tracker, const char *device, enum latency_kind kind,
+										struct wlr_surface *surface, uint32_t time_msec);
+void latency_surface_commit(struct latency_tracker *tracker, struct wlr_surface *surface);
+void latency_surface_destroy(struct latency_tracker *tracker, struct wlr_surface *surface);
+void latency_output_commit(struct latency_tracker *tracker, struct wlr_output *output,
+										latency_shown_func_t shown, void *data);
+void latency_output_present(struct latency_tracker *tracker,
+										struct wlr_output_event_present *event);
+void latency_output_destroy(struct latency_tracker *tracker, struct wlr_output *output);
+
+/* Logs the histograms of every device */
+void latency_dump(const struct latency_tracker *tracker);
+
+#endif
@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Starts commands from the compositor without ever blocking the event loop.
+ * Children are created with posix_spawn straight from the compositor process
+ * and reaped from a SIGCHLD source on the Wayland event loop, so launching an
+ * application costs one spawn call and no waitpid. Commands come from the
+ * command cache, already split and resolved:
+ *	launcher_spawn(server->launcher, cmdcache_add(server->commands, "foot"));
+ */
+
+#include <spawn.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <wlr/util/log.h>
+#include "launcher.h"
+
+extern char **environ;
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void reap_children(struct launcher *launcher) {
+	int status;
+	pid_t pid;
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		launcher->stats.reaped++;
+		struct launcher_child *child, *tmp;
+		wl_list_for_each_safe(child, tmp, &launcher->children, link) {
+			if (child->pid != pid) {
+				continue;
+			}
+			wlr_log(WLR_DEBUG, "'%s' (pid %d) exited with status %d after %.1f s",
+							child->name, pid, WIFEXITED(status) ? WEXITSTATUS(status) : -1,
+							(now_ns() - child->start_ns) / 1e9);
+			wl_list_remove(&child->link);
+			free(child->name);
+			free(child);
+			break;
+		}
+	}
+}
+
+static int handle_sigchld(int signal_number, void *data) {
+	(void)signal_number;
+	reap_children(data);
+	return 0;
+}
+
+struct launcher *launcher_create(struct wl_event_loop *loop) {
+	struct launcher *launcher = calloc(1, sizeof(struct launcher));
+	if (!launcher) {
+		return NULL;
+	}
+	wl_list_init(&launcher->children);
+	// The compositor blocks SIGCHLD for the signalfd, the children must not inherit that
+	posix_spawnattr_init(&launcher->attr);
+	sigset_t mask;
+	sigemptyset(&mask);
+	posix_spawnattr_setsigmask(&launcher->attr, &mask);
+	sigset_t defaults;
+	sigemptyset(&defaults);
+	sigaddset(&defaults, SIGCHLD);
+	sigaddset(&defaults, SIGPIPE);
+	posix_spawnattr_setsigdefault(&launcher->attr, &defaults);
+	posix_spawnattr_setflags(&launcher->attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+	// Blocks SIGCHLD and delivers it through a signalfd on the event loop
+	launcher->sigchld = wl_event_loop_add_signal(loop, SIGCHLD, handle_sigchld, launcher);
+	if (!launcher->sigchld) {
+		wlr_log(WLR_ERROR, "Error: Failed to add SIGCHLD source in 'launcher_create'!");
+		posix_spawnattr_destroy(&launcher->attr);
+		free(launcher);
+		return NULL;
+	}
+	// Children that exited before the source existed
+	reap_children(launcher);
+	return launcher;
+}
+
+void launcher_destroy(struct launcher *launcher) {
+	if (!launcher) {
+		return;
+	}
+	launcher_log_stats(launcher);
+	struct launcher_child *child, *tmp;
+	wl_list_for_each_safe(child, tmp, &launcher->children, link) {
+		wl_list_remove(&child->link);
+		free(child->name);
+		free(child);
+	}
+	wl_event_source_remove(launcher->sigchld);
+	posix_spawnattr_destroy(&launcher->attr);
+	free(launcher);
+}
+
+pid_t launcher_spawn(struct launcher *launcher, const struct cmdcache_entry *command) {
+	if (!launcher || !command) {
+		return -1;
+	}
+	if (!command->path) {
+		launcher->stats.failures++;
+		wlr_log(WLR_ERROR, "Error: '%s' not found, provide the full path to it",
+																command->argv[0]);
+		return -1;
+	}
+
+	pid_t pid;
+	uint64_t start = now_ns();
+	int status = posix_spawn(&pid, command->path, NULL, &launcher->attr, command->argv,
+																			environ);
+	uint64_t elapsed = now_ns() - start;
+
+	if (status != 0) {
+		launcher->stats.failures++;
+		wlr_log(WLR_ERROR, "Error: %s. Failed to launch '%s'", strerror(status), command->path);
+		return -1;
+	}
+
+	struct launcher_stats *stats = &launcher->stats;
+	stats->launches++;
+	stats->total_ns += elapsed;
+	if (stats->min_ns == 0 || elapsed < stats->min_ns) {
+		stats->min_ns = elapsed;
+	}
+	if (elapsed > stats->max_ns) {
+		stats->max_ns = elapsed;
+	}
+	wlr_log(WLR_DEBUG, "Launched '%s' (pid %d) in %.1f us", command->path, pid, elapsed / 1e3);
+
+	struct launcher_child *child = calloc(1, sizeof(struct launcher_child));
+	if (child) {
+		child->pid = pid;
+		child->name = strdup(command->argv[0]);
+		child->start_ns = start;
+		wl_list_insert(&launcher->children, &child->link);
+	}
+	return pid;
+}
+
+void launcher_log_stats(const struct launcher *launcher) {
+	const struct launcher_stats *stats = &launcher->stats;
+	if (stats->launches == 0) {
+		wlr_log(WLR_INFO, "Launcher: nothing launched, %lu failures", stats->failures);
+		return;
+	}
+	wlr_log(WLR_INFO, "Launcher: %lu launches, %lu failures, %lu reaped, spawn latency "
+				"min %.1f us avg %.1f us max %.1f us", stats->launches, stats->failures,
+				stats->reaped, stats->min_ns / 1e3,
+				stats->total_ns / 1e3 / stats->launches, stats->max_ns / 1e3);
+}
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef LAUNCHER_H_
+#define LAUNCHER_H_
+
+#include <spawn.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <wayland-server-core.h>
+#include "cmdcache.h"
+
+/* A process started by the launcher that has not been reaped yet */
+struct launcher_child {
+	struct wl_list link;
+	pid_t pid;
+	char *name;						// argv[0], for the logs
+	uint64_t start_ns;				// CLOCK_MONOTONIC when it was spawned
+};
+
+/* Cost of the posix_spawn call as seen by the compositor */
+struct launcher_stats {
+	unsigned long launches;
+	unsigned long failures;
+	unsigned long reaped;
+	uint64_t total_ns;
+	uint64_t min_ns;
+	uint64_t max_ns;
+};
+
+struct launcher {
+	struct wl_event_source *sigchld;	// signalfd source on the display event loop
+	struct wl_list children;			// launcher_child::link
+	struct launcher_stats stats;
+	posix_spawnattr_t attr;				// signal mask and dispositions for the children
+};
+
+struct launcher *launcher_create(struct wl_event_loop *loop);
+void launcher_destroy(struct launcher *launcher);
+
+/* Starts the command without waiting for it, returns its pid or -1 */
+pid_t launcher_spawn(struct launcher *launcher, const struct cmdcache_entry *command);
+void launcher_log_stats(const struct launcher *launcher);
+
+#endif
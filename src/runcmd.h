@@ -1,6 +0,0 @@
-// SPDX-License-Identifier: GPL-2.0-or-later
-
-#ifndef RUNCMD_H_
-#define RUNCMD_H_
-	void run_cmd(char *command);
-#endif
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/* Small fork/join worker pool for CPU compositing.
+ * The workers are started once and sleep on a condition variable between
+ * frames. A batch is a parallel for over 'count' indices: workers and the
+ * calling thread take indices from an atomic counter until none are left, so
+ * tiles that take longer don't leave the other threads idle. tilepool_run only
+ * returns when every index was processed, the caller can then commit the
+ * frame knowing nobody writes to it any more.
+ */
+
+#include <stdlib.h>
+#include <wlr/util/log.h>
+#include "tilepool.h"
+
+static void run_batch(struct tilepool *pool) {
+	size_t index;
+	while ((index = atomic_fetch_add(&pool->next, 1)) < pool->count) {
+		pool->func(index, pool->data);
+	}
+}
+
+static void *worker_main(void *data) {
+	struct tilepool *pool = data;
+	unsigned long seen = 0;
+	pthread_mutex_lock(&pool->lock);
+	while (true) {
+		while (pool->generation == seen && !pool->quit) {
+			pthread_cond_wait(&pool->start, &pool->lock);
+		}
+		if (pool->quit) {
+			break;
+		}
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		run_batch(pool);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->busy == 0) {
+			pthread_cond_signal(&pool->done);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+struct tilepool *tilepool_create(int num_threads) {
+	struct tilepool *pool = calloc(1, sizeof(struct tilepool));
+	if (!pool) {
+		return NULL;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	atomic_init(&pool->next, 0);
+	if (num_threads > 1) {
+		pool->threads = calloc(num_threads - 1, sizeof(pthread_t));
+		if (!pool->threads) {
+			tilepool_destroy(pool);
+			return NULL;
+		}
+	}
+	for (int i = 0; i < num_threads - 1; i++) {
+		if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) {
+			wlr_log(WLR_ERROR, "Error: Failed to start worker thread in 'tilepool_create'!");
+			break;
+		}
+		pool->num_threads++;
+	}
+	return pool;
+}
+
+void tilepool_destroy(struct tilepool *pool) {
+	if (!pool) {
+		return;
+	}
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	for (int i = 0; i < pool->num_threads; i++) {
+		pthread_join(pool->threads[i], NULL);
+	}
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->threads);
+	free(pool);
+}
+
+void tilepool_run(struct tilepool *pool, size_t count, tilepool_func_t func, void *data) {
+	if (count == 0) {
+		return;
+	}
+	pthread_mutex_lock(&pool->lock);
+	pool->func = func;
+	pool->data = data;
+	pool->count = count;
+	atomic_store(&pool->next, 0);
+	pool->busy = pool->num_threads;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	// The caller works too instead of waiting
+	run_batch(pool);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->busy > 0) {
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
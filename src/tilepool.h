@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#ifndef TILEPOOL_H_
+#define TILEPOOL_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/* Called once for every index of a batch, from any thread of the pool */
+typedef void (*tilepool_func_t)(size_t index, void *data);
+
+struct tilepool {
+	pthread_t *threads;
+	int num_threads;				// workers, the caller of tilepool_run is one more
+	pthread_mutex_t lock;
+	pthread_cond_t start;			// a new batch was posted or quit was set
+	pthread_cond_t done;			// the last worker left the batch
+	unsigned long generation;		// incremented for every batch
+	int busy;						// workers still in the current batch
+	bool quit;
+	// Current batch, written under the lock before the generation changes
+	tilepool_func_t func;
+	void *data;
+	size_t count;
+	atomic_size_t next;				// next index to hand out
+};
+
+/* 'num_threads' counts the calling thread, 1 runs every batch inline */
+struct tilepool *tilepool_create(int num_threads);
+void tilepool_destroy(struct tilepool *pool);
+
+/* Calls func(i, data) for i in [0, count) and returns once all calls returned */
+void tilepool_run(struct tilepool *pool, size_t count, tilepool_func_t func, void *data);
+
+#endif
@@ -5,35 +5,50 @@
 /* Minimal but functional Wayland compositor. */
 
 ///#define _POSIX_C_SOURCE 200112L
-#define STB_IMAGE_IMPLEMENTATION // needed for background image implementation
 #define TOUCHPAD_SCROLL_SCALE 0.7 // Scaling factor for touchpad scrolls
 #define MOUSE_SCROLL_SCALE 1.0 // Scaling factor for mouse wheel scrolls
 #define SCROLL_DEBOUNCE_THRESHOLD 2.0 // Threshold to filter out small scroll values
-#define MAX_NR_OF_STARTUP_COMMANDS 265 // maximum number of user defined startup commands
+#define FRAME_THROTTLE_INTERVAL_MS 1000 // Frame callback period of hidden and minimized views
+#define MAX_OUTPUTS 32 // Outputs a view can be on are kept in a 32 bit mask
+#define CPU_TILE_SIZE 128 // Side of the tiles the CPU compositing path splits the damage into
+#define MAX_CURSOR_SCALES 8 // Output scales the cursor theme is loaded at
+#define TREE_LAYOUT_SEED 14695981039346656037ull // FNV-1a basis of 'tree_layout_hash'
+#define TREE_LAYOUT_PRIME 1099511628211ull // FNV-1a prime of 'tree_layout_hash'
 
 /* Local headers */
-#include "runcmd.h"
+#include "autostart.h"
+#include "bgloader.h"
+#include "cmdcache.h"
+#include "launcher.h"
+#include "configstore.h"
 #include "create-config.c"
 #include "getxkbkeyname.h"
-#include "getvaluefromconf.h"
+#include "histogram.h"
+#include "hitgrid.h"
+#include "latency.h"
+#include "keybindings.h"
+#include "tilepool.h"
 
 /* System headers */
 #include <time.h>
 #include <stdio.h>
+#include <signal.h>
 #include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <math.h>
 #include <stdbool.h>
 #include <libinput.h>
 #include <GLES3/gl3.h>
 #include <GLES3/gl32.h>
 #include <wlr/backend.h>
 #include <wlr/util/log.h>
-#include <stb/stb_image.h>
 #include <pixman-1/pixman.h>
 #include <wlr/util/region.h>
+#include <wlr/util/box.h>
 #include <libdrm/drm_fourcc.h>
 #include <wlr/types/wlr_seat.h>
 #include <wlr/types/wlr_idle.h>
@@ -41,13 +56,19 @@
 #include <wayland-server-core.h>
 #include <wlr/backend/session.h>
 #include <wlr/backend/libinput.h>
+#include <wlr/render/gles2.h>
+#include <wlr/render/pixman.h>
 #include <wlr/render/allocator.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_damage.h>
 #include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_region.h>
 #include <wlr/types/wlr_pointer.h>
 #include <wlr/types/wlr_keyboard.h>
+#include <wlr/types/wlr_keyboard_group.h>
 #include <wlr/render/wlr_texture.h>
 #include <linux/input-event-codes.h>
 #include <wayland-server-protocol.h>
@@ -65,6 +86,7 @@
 #include <wlr/types/wlr_data_control_v1.h>
 #include <wlr/types/wlr_relative_pointer_v1.h>
 #include <wlr/types/wlr_virtual_keyboard_v1.h>
+#include <wlr/types/wlr_virtual_pointer_v1.h>
 #include <wlr/types/wlr_output_management_v1.h>
 #include <wlr/types/wlr_pointer_constraints_v1.h>
 #include <wlr/types/wlr_foreign_toplevel_management_v1.h>
@@ -82,13 +104,20 @@ struct woodland_server {
 	struct wlr_renderer *renderer;
 	struct wlr_allocator *allocator;
 	struct wlr_compositor *compositor;
-	struct wlr_texture *background_texture;
-	// Timer
-	struct wl_event_source *timer;
-	struct wl_event_source *autostart_timer;
+	struct wl_listener new_surface;
+	struct bgloader *bgloader;		// decodes and scales the background on a worker thread
+	const char *background_path;	// NULL without a background image
+	enum imagescale_mode background_mode;
+	uint32_t background_format;		// DRM format the background is scaled to
+	struct tilepool *tilepool;		// CPU compositing workers, pixman renderer only
+	struct histogram key_time;		// time spent in 'keyboard_handle_key'
+	struct histogram motion_time;	// time spent in 'process_cursor_motion'
+	struct latency_tracker *latency;	// input events followed to the screen, dumped on SIGUSR1
 	// XDG Shell
 	struct wl_list views;
 	struct wl_list minimized_views; // list for minimized views
+	struct wl_event_source *frame_throttle_timer;	// frame callbacks of hidden views
+	bool frame_throttle_armed;
 	struct wlr_xdg_shell *xdg_shell;
 	struct wl_listener new_xdg_surface;
 	// Idle
@@ -105,6 +134,10 @@ struct woodland_server {
 	// Virtual Keyboard
 	struct wlr_virtual_keyboard_manager_v1 *virtual_keyboard_mgr;
 	struct wl_listener new_virtual_keyboard;
+	struct wl_list virtual_keyboards;
+	// Virtual pointer
+	struct wlr_virtual_pointer_manager_v1 *virtual_pointer_mgr;
+	struct wl_listener new_virtual_pointer;
 	// Foreign toplevel manager
 	struct wlr_foreign_toplevel_manager_v1 *wlr_foreign_toplevel_mgr;
 	// Output manager
@@ -130,9 +163,16 @@ struct woodland_server {
 	struct wl_listener cursor_motion;
 	struct wl_listener cursor_button;
 	struct wlr_xcursor_manager *cursor_mgr;
+	const char *cursor_name;		// themed image shown, NULL for a client surface
+	float cursor_scales[MAX_CURSOR_SCALES];	// scales 'cursor_mgr' has loaded the theme at
+	int num_cursor_scales;
+	unsigned long cursor_image_sets;	// themed or client images handed to the cursor
+	unsigned long cursor_images_kept;	// requests for the image already shown
 	struct wl_listener cursor_motion_absolute;
 	struct wlr_seat *seat;
-	struct wl_list keyboards;
+	struct wl_list keyboards;			// physical keyboards, members of keyboard_group
+	struct wlr_keyboard_group *keyboard_group;
+	struct woodland_keyboard *group_keyboard;	// key and modifier events of the group
 	struct wlr_box grab_geobox;
 	struct wl_listener new_input;
 	struct wl_listener request_cursor;
@@ -140,43 +180,149 @@ struct woodland_server {
 	struct wl_list outputs;
 	struct wl_listener new_output;
 	struct wlr_output_layout *output_layout;
+	struct wl_listener output_layout_change;
 	struct wlr_surface *prev_surface;
 	struct woodland_view *grabbed_view;
 	enum woodland_cursor_mode cursor_mode;
+	struct xkb_context *xkb_context;
+	struct xkb_keymap *keymap;		// all xkb_layouts as groups, compiled once
 	xkb_layout_index_t LayoutIndexes;
 	double grab_x;
 	double grab_y;
-	float matrix[9];
-	float background_matrix[9];
 	uint32_t modifier;
 	uint32_t resize_edges;
 	uint32_t saved_brightness;
 	bool idle_enabled;
 	bool should_render;
-	bool render_full_stop;
 	bool super_key_down;
 	bool keybind_handled;
 	bool layer_view_found;
+	bool motion_pending;			// the cursor moved, focus and hit-testing didn't follow yet
+	bool motion_pan_pending;		// a relative motion may pan the zoomed output
+	bool motion_frame_pending;		// the pointer frame is sent after the deferred motion
+	bool motion_frame_relative;		// relative motion went out in the current pointer frame
+	uint32_t motion_time_msec;		// time of the last motion event not processed yet
+	char motion_device[64];			// name of its device, for the latency of the motion
+	unsigned long motions_coalesced;	// motion events folded into a later one
+	unsigned long resize_configures;	// sizes sent to clients during interactive resizes
+	unsigned long resizes_coalesced;	// sizes replaced while a configure was in flight
+	unsigned long hit_stack;		// last stacking order handed out, see 'struct hit_target'
 	char *config;
-	char *brightness_path;
-	char *play_pause;
-	char *volume_up;
-	char *volume_down;
-	char *volume_mute;
+	struct config_store *conf;		// woodland.ini parsed once at startup
+	struct keybindings *keybindings;	// precompiled keyboard shortcuts
+	struct launcher *launcher;		// spawns commands without blocking the event loop
+	struct autostart *autostart;	// startup commands, launched once an output is ready
+	const char *brightness_path;
+	struct cmdcache *commands;		// configured commands, split and resolved in $PATH
+	struct cmdcache_entry *play_pause;
+	struct cmdcache_entry *volume_up;
+	struct cmdcache_entry *volume_down;
+	struct cmdcache_entry *volume_mute;
 	// Zooming
 	double zoom_speed;				// Speed of panning
 	double zoom_factor;				// How large the zooming area should be on one scroll
 	double pan_offset_x;			// Pan offset for x-axis
 	double pan_offset_y;			// Pan offset for y-axis
 	double zoom_edge_threshold;		// How far from screen edges the zoom pan should start
-	char *zoom_top_edge;			// set to enabled in woodland.ini to zoom on top left corcer
+	const char *zoom_top_edge;		// set to enabled in woodland.ini to zoom on top left corcer
+	bool zoom_filter_nearest;		// zoom_filter = nearest in woodland.ini, sharp pixels
+};
+
+/* One surface of the output's render list, everything needed to draw it is
+ * computed when the list is built so a frame is a linear pass over an array.
+ */
+struct render_item {
+	struct wlr_surface *surface;
+	struct woodland_view *view;		// NULL for layer surfaces
+	struct wlr_texture *texture;	// refreshed on every commit of the surface
+	struct wlr_fbox src_box;		// part of the buffer shown, set by viewporter
+	struct wlr_box box;				// output-local coordinates
+	float matrix[9];				// projection of 'box' on the output
+	float alpha;
+	pixman_region32_t visible;		// this frame: damaged part not hidden by opaque surfaces above
+	bool occluded;					// this frame: nothing visible, not drawn
+};
+
+/* One draw of the CPU compositing path: a pixman image, or a solid color when
+ * 'pixels' is NULL, composited on 'region'. Filled by the compositor thread,
+ * only read by the tile workers.
+ */
+struct cpu_op {
+	pixman_region32_t *region;		// output-local, not owned
+	pixman_op_t op;
+	pixman_format_code_t format;
+	uint32_t *pixels;
+	int width;
+	int height;
+	int stride;
+	pixman_transform_t transform;	// output-local to source coordinates
+	pixman_filter_t filter;
+	pixman_color_t color;
+};
+
+/* Target and draws of a frame composited on the tile pool */
+struct cpu_frame {
+	pixman_format_code_t format;
+	uint32_t *pixels;
+	int width;
+	int height;
+	int stride;
+	const struct cpu_op *ops;		// bottom to top
+	size_t num_ops;
+	const pixman_box32_t *tiles;
 };
 
 struct woodland_output {
 	struct wl_list link;
 	struct wl_listener frame;
+	struct wl_listener destroy;
+	struct wl_listener commit;
+	struct wl_listener present;
 	struct wlr_output *wlr_output;
+	struct wlr_output_damage *damage;	// accumulated damage, emits frame when needed
 	struct woodland_server *server;
+	struct wlr_box layout_box;			// position and size in the output layout
+	int index;							// bit of this output in view->outputs
+	bool frame_pending;					// a frame was requested and didn't arrive yet
+	bool blanked;						// idle, the screen is black until resumed
+	unsigned long frames_rendered;
+	unsigned long frames_skipped;		// frame events that found nothing to repaint
+	unsigned long surfaces_culled;		// surfaces not drawn, occluded or outside the damage
+	struct render_item *render_items;	// surfaces on this output, bottom to top
+	size_t num_render_items;
+	size_t cap_render_items;
+	bool render_list_dirty;				// views were mapped, moved, raised or resized
+	unsigned long render_list_builds;
+	struct wlr_buffer *zoom_buffer;		// the magnifier renders the scene here first
+	struct wlr_texture *zoom_texture;	// 'zoom_buffer' sampled up to the output
+	pixman_box32_t *cpu_tiles;
+	size_t cap_cpu_tiles;
+	unsigned long frames_cpu_tiled;
+	unsigned long frames_hardware_cursor;	// frames with the cursor on the hardware plane
+	unsigned long frames_software_cursor;	// frames the cursor was composited into
+	struct histogram frame_time;		// time spent in 'output_frame' for rendered frames
+	struct wlr_texture *background_texture;	// the background scaled to this output
+	float background_matrix[9];
+	int background_width;				// size the background was last requested at
+	int background_height;
+	struct background_request *background_request;	// scaling in flight, if any
+	struct hitgrid *hitgrid;			// views and layer surfaces over 'layout_box'
+};
+
+/* Job data of a background scaling, outlives its output if that goes away */
+struct background_request {
+	struct woodland_output *output;		// NULL once the result is not wanted
+};
+
+/* A view or a layer surface as seen by pointer hit-testing, entered into the
+ * hit grid of every output its bounding box touches.
+ */
+struct hit_target {
+	struct woodland_view *view;		// one of the two is set
+	struct woodland_layer_view *layer_view;
+	struct wlr_box box;				// every surface and popup, layout coordinates
+	unsigned long stack;			// higher is hit first, raised views get a new one
+	bool indexed;					// 'box' is in the hit grids
 };
 
 struct woodland_view {
@@ -199,12 +345,27 @@ struct woodland_view {
 	xkb_layout_index_t keyboard_layout;
 	bool is_fullscreen;
 	bool mapped;
+	uint32_t outputs;				// bit 'index' of every output the view intersects
+	uint32_t visible_outputs;		// outputs the view was visible on in their last frame
+	bool throttled;					// frame callbacks every FRAME_THROTTLE_INTERVAL_MS only
+	unsigned long frames_done;		// frames with callbacks sent at full rate
+	unsigned long frames_throttled;	// callbacks sent by the throttle timer
 	int original_x;
 	int original_y;
 	int original_width;
 	int original_height;
 	int x;
 	int y;
+	struct hit_target hit;
+	uint64_t tree_layout;			// see 'tree_layout_hash'
+	/* Interactive resize transaction: at most one configure in flight, the
+	 * position follows once the client commits a buffer acking it */
+	uint32_t resize_serial;			// configure in flight, 0 when none
+	struct wlr_box resize_box;		// geometry asked for by it, layout coordinates
+	uint32_t resize_edges;			// grabbed edges, the opposite ones stay in place
+	bool resize_pending;			// 'resize_next' waits for the configure in flight
+	struct wlr_box resize_next;
+	uint32_t resize_next_edges;
 };
 
 struct woodland_layer_view {
@@ -218,6 +379,8 @@ struct woodland_layer_view {
 	bool mapped;
 	double x;
 	double y;
+	struct hit_target hit;
+	uint64_t tree_layout;			// see 'tree_layout_hash'
 };
 
 struct woodland_keyboard {
@@ -230,112 +393,550 @@ struct woodland_keyboard {
 	bool destroyed;
 };
 
-/* Takes an index, looks for it in a string and then returns a new string with
- * the layout at the given index placed in the first position. The remaining
- * layouts will be arranged in their original order, with elements separated
- * by commas. I use it to re-arrange the layouts to place the chosen layout
- * at position 0. It is needed in order to change the layout per application.
+/* Every wl_surface of every client, its commits become output damage */
+struct woodland_surface {
+	struct woodland_server *server;
+	struct wlr_surface *surface;
+	struct wl_listener commit;
+	struct wl_listener destroy;
+};
+
+/* Monotonic clock of the timing statistics */
+static uint64_t timing_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/****************************** Damage tracking ******************************/
+/* Views live in layout coordinates and are damaged on every output they
+ * intersect, translated to output-local coordinates. Layer surfaces belong to
+ * a single output and are already output-local. wlr_output_damage schedules a
+ * frame only when something was damaged.
  */
-char *updated_layouts(char *index, char *layouts) {
-	if (!index || !layouts) {
-		return NULL;
+static void damage_box(struct woodland_server *server, struct wlr_output *wlr_output,
+																struct wlr_box *box) {
+	struct woodland_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (wlr_output) {
+			if (output->wlr_output == wlr_output) {
+				wlr_output_damage_add_box(output->damage, box);
+			}
+			continue;
+		}
+		struct wlr_box local = *box;
+		local.x -= output->layout_box.x;
+		local.y -= output->layout_box.y;
+		wlr_output_damage_add_box(output->damage, &local);
 	}
+}
 
-	// Copy layouts to a temporary buffer to avoid modifying the original string
-	char *layouts_copy = strdup(layouts);
-	if (!layouts_copy) {
-		return NULL;
+static void damage_region(struct woodland_server *server, struct wlr_output *wlr_output,
+														pixman_region32_t *region) {
+	struct woodland_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (wlr_output) {
+			if (output->wlr_output == wlr_output) {
+				wlr_output_damage_add(output->damage, region);
+			}
+			continue;
+		}
+		pixman_region32_translate(region, -output->layout_box.x, -output->layout_box.y);
+		wlr_output_damage_add(output->damage, region);
+		pixman_region32_translate(region, output->layout_box.x, output->layout_box.y);
 	}
+}
 
-	// Find the starting position of 'index' in 'layouts_copy'
-	char *start = strstr(layouts_copy, index);
-	if (!start) {
-		free(layouts_copy);
-		return strdup(layouts); // If 'index' is not found, return the original string
+/* Frames are requested here or by the output damage, never in a loop: when no
+ * damage, frame callback or cursor update is pending the outputs stay quiet.
+ */
+static void output_schedule_frame(struct woodland_output *output) {
+	if (output->frame_pending) {
+		return;
 	}
+	output->frame_pending = true;
+	wlr_output_schedule_frame(output->wlr_output);
+}
 
-	// Find the end position of 'index' in 'layouts_copy'
-	char *end = start + strlen(index);
+/* Hidden and minimized views get their frame callbacks from a slow timer,
+ * armed only while there are such views.
+ */
+static void frame_throttle_arm(struct woodland_server *server) {
+	if (server->frame_throttle_armed || !server->frame_throttle_timer) {
+		return;
+	}
+	server->frame_throttle_armed = true;
+	wl_event_source_timer_update(server->frame_throttle_timer, FRAME_THROTTLE_INTERVAL_MS);
+}
 
-	// Allocate memory for the new layouts string
-	size_t new_layouts_size = strlen(layouts) + 1;
-	char *new_layouts = malloc(new_layouts_size);
-	if (!new_layouts) {
-		free(layouts_copy);
-		return NULL;
+/* The render lists are rebuilt on the next frame, only needed when the scene
+ * changes: a surface is mapped, unmapped, moved, raised or resized.
+ */
+static void render_lists_invalidate(struct woodland_server *server) {
+	struct woodland_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		output->render_list_dirty = true;
 	}
+}
 
-	// Copy 'index' to the beginning of the new layouts string
-	strcpy(new_layouts, index);
+static void damage_whole(struct woodland_server *server) {
+	struct woodland_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		wlr_output_damage_add_whole(output->damage);
+	}
+	render_lists_invalidate(server);
+}
+
+struct surface_damage_data {
+	struct woodland_server *server;
+	struct wlr_surface *target;		// only this surface, NULL for all of them
+	struct wlr_output *output;		// output of a layer surface, NULL for views
+	int x;							// position of the view or layer surface
+	int y;
+	bool whole;
+	bool found;
+	uint64_t layout;				// every surface of the tree, see 'tree_layout_hash'
+};
 
-	// Copy the remaining layouts in their original order, starting from the end of 'index'
-	if (*end == ',') {
-		end++; // Skip the comma after 'index'
+/* Subsurfaces and popups move or restack, and buffers get an offset, on a
+ * commit without any surface changing size, which the render lists would not
+ * notice. A hash of every surface of a tree in drawing order and where it is
+ * tells when that happened.
+ */
+static void tree_layout_hash(uint64_t *hash, struct wlr_surface *surface, int sx, int sy) {
+	uint64_t values[5] = {(uintptr_t)surface, (uint32_t)sx, (uint32_t)sy,
+							(uint32_t)surface->current.dx, (uint32_t)surface->current.dy};
+	for (int i = 0; i < 5; i++) {
+		*hash = (*hash ^ values[i]) * TREE_LAYOUT_PRIME;
 	}
-	char *remaining = end;
-	while (*remaining != '\0') {
-		strncat(new_layouts, ",", new_layouts_size - strlen(new_layouts) - 1);
-		char *comma = strchr(remaining, ',');
-		if (!comma) {
-			strncat(new_layouts, remaining, new_layouts_size - strlen(new_layouts) - 1);
-			break;
+}
+
+static void damage_surface_iterator(struct wlr_surface *surface, int sx, int sy, void *data) {
+	struct surface_damage_data *ddata = data;
+	tree_layout_hash(&ddata->layout, surface, sx, sy);
+	if (ddata->target && surface != ddata->target) {
+		return;
+	}
+	ddata->found = true;
+	struct wlr_box box = {
+		.x = ddata->x + sx,
+		.y = ddata->y + sy,
+		.width = surface->current.width > surface->pending.width ?
+								surface->current.width : surface->pending.width,
+		.height = surface->current.height > surface->pending.height ?
+								surface->current.height : surface->pending.height,
+	};
+	// A resized surface may have left parts of its old size behind
+	if (ddata->whole || surface->current.width != surface->previous.width ||
+						surface->current.height != surface->previous.height) {
+		render_lists_invalidate(ddata->server);
+		if (surface->previous.width > box.width) {
+			box.width = surface->previous.width;
+		}
+		if (surface->previous.height > box.height) {
+			box.height = surface->previous.height;
 		}
-		strncat(new_layouts, remaining, comma - remaining);
-		remaining = comma + 1;
+		damage_box(ddata->server, ddata->output, &box);
+		return;
 	}
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	wlr_surface_get_effective_damage(surface, &damage);
+	pixman_region32_translate(&damage, box.x, box.y);
+	damage_region(ddata->server, ddata->output, &damage);
+	pixman_region32_fini(&damage);
+}
 
-	// Now copy the layouts that were before 'index' in the original string
-	char *current = layouts_copy;
-	while (current < start) {
-		strncat(new_layouts, ",", new_layouts_size - strlen(new_layouts) - 1);
-		char *comma = strchr(current, ',');
-		if (!comma || comma >= start) {
-			strncat(new_layouts, current, start - current);
-			break;
+/* Damages everything the view covers, used when it is mapped, moved or raised */
+static void view_damage_whole(struct woodland_view *view) {
+	if (!view->mapped) {
+		return;
+	}
+	struct surface_damage_data ddata = {
+		.server = view->server,
+		.x = view->x,
+		.y = view->y,
+		.whole = true,
+	};
+	wlr_xdg_surface_for_each_surface(view->xdg_surface, damage_surface_iterator, &ddata);
+}
+
+/**************************** Hit-testing index *****************************/
+/* Pointer events look up the hit grid of the output under the cursor and only
+ * walk the surface trees of the candidates found there, see 'desktop_view_at'.
+ * The boxes follow the same changes as the outputs a view is on: map, unmap,
+ * move and every commit, which covers resizes and popups.
+ */
+static void hit_bounds_iterator(struct wlr_surface *surface, int sx, int sy, void *data) {
+	struct wlr_box *bounds = data;
+	struct wlr_box box = {
+		.x = sx,
+		.y = sy,
+		.width = surface->current.width,
+		.height = surface->current.height,
+	};
+	if (wlr_box_empty(&box)) {
+		return;
+	}
+	if (wlr_box_empty(bounds)) {
+		*bounds = box;
+		return;
+	}
+	int x2 = bounds->x + bounds->width > box.x + box.width ?
+								bounds->x + bounds->width : box.x + box.width;
+	int y2 = bounds->y + bounds->height > box.y + box.height ?
+								bounds->y + bounds->height : box.y + box.height;
+	bounds->x = bounds->x < box.x ? bounds->x : box.x;
+	bounds->y = bounds->y < box.y ? bounds->y : box.y;
+	bounds->width = x2 - bounds->x;
+	bounds->height = y2 - bounds->y;
+}
+
+/* Moves the target to 'box' in the hit grids, an empty box takes it out */
+static void hit_target_set_box(struct woodland_server *server, struct hit_target *target,
+															const struct wlr_box *box) {
+	bool indexed = !wlr_box_empty(box);
+	if (indexed == target->indexed && (!indexed || (box->x == target->box.x &&
+								box->y == target->box.y && box->width == target->box.width &&
+								box->height == target->box.height))) {
+		return;
+	}
+	struct woodland_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (!output->hitgrid) {
+			continue;
+		}
+		if (target->indexed) {
+			hitgrid_remove(output->hitgrid, target, &target->box);
+		}
+		if (indexed) {
+			hitgrid_insert(output->hitgrid, target, box);
 		}
-		strncat(new_layouts, current, comma - current);
-		current = comma + 1;
 	}
+	target->box = indexed ? *box : (struct wlr_box){0};
+	target->indexed = indexed;
+}
 
-	// Remove trailing comma if it exists
-	if (new_layouts[strlen(new_layouts) - 1] == ',') {
-		new_layouts[strlen(new_layouts) - 1] = '\0';
+static void view_update_hit_box(struct woodland_view *view) {
+	struct wlr_box box = {0};
+	if (view->mapped) {
+		wlr_xdg_surface_for_each_surface(view->xdg_surface, hit_bounds_iterator, &box);
+		box.x += view->x;
+		box.y += view->y;
 	}
+	hit_target_set_box(view->server, &view->hit, &box);
+}
 
-	free(layouts_copy);
-	layouts_copy = NULL;
-	return new_layouts;
+static void layer_view_update_hit_box(struct woodland_layer_view *layer_view) {
+	struct wlr_box box = {0};
+	if (layer_view->mapped) {
+		wlr_layer_surface_v1_for_each_surface(layer_view->layer_surface, hit_bounds_iterator, &box);
+		box.x += (int)layer_view->x;
+		box.y += (int)layer_view->y;
+	}
+	hit_target_set_box(layer_view->server, &layer_view->hit, &box);
 }
 
-/* Given a number index, it looks through a string of words devided by comma
- * and returns the word at given index.
+/* The views were reordered other than by raising one, they get stacking
+ * numbers from the bottom of the list up.
  */
-char *layout_name_from_index(int index, char *layouts) {
-	if (!layouts || index < 0) {
-		return NULL;
+static void hit_stack_renumber(struct woodland_server *server) {
+	struct woodland_view *view;
+	wl_list_for_each_reverse(view, &server->views, link) {
+		view->hit.stack = ++server->hit_stack;
 	}
+}
 
-	// Copy layouts to a temporary buffer to avoid modifying the original string
-	char *layouts_copy = strdup(layouts);
-	if (!layouts_copy) {
-		return NULL;
+/* The outputs moved or changed size, every grid is filled again */
+static void hit_grids_rebuild(struct woodland_server *server) {
+	struct woodland_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (!output->hitgrid) {
+			continue;
+		}
+		hitgrid_reset(output->hitgrid, &output->layout_box);
+		struct woodland_view *view;
+		wl_list_for_each(view, &server->views, link) {
+			if (view->hit.indexed) {
+				hitgrid_insert(output->hitgrid, &view->hit, &view->hit.box);
+			}
+		}
+		struct woodland_layer_view *layer_view;
+		wl_list_for_each(layer_view, &server->layer_surfaces, link) {
+			if (layer_view->hit.indexed) {
+				hitgrid_insert(output->hitgrid, &layer_view->hit, &layer_view->hit.box);
+			}
+		}
 	}
+}
 
-	char *layout_name = NULL;
-	char *token = strtok(layouts_copy, ",");
-	int current_index = 0;
+struct surface_output_data {
+	struct wlr_output *output;
+	bool enter;
+};
 
-	while (token) {
-		if (current_index == index) {
-			layout_name = strdup(token);
-			break;
+static void surface_output_iterator(struct wlr_surface *surface, int sx, int sy, void *data) {
+	(void)sx;
+	(void)sy;
+	struct surface_output_data *odata = data;
+	if (odata->enter) {
+		wlr_surface_send_enter(surface, odata->output);
+	}
+	else {
+		wlr_surface_send_leave(surface, odata->output);
+	}
+}
+
+/* Sets the outputs the view is on and sends wl_surface enter and leave for the
+ * ones that changed, so clients know which output's scale and refresh to use.
+ */
+static void view_set_outputs(struct woodland_view *view, uint32_t outputs) {
+	uint32_t changed = view->outputs ^ outputs;
+	if (!changed) {
+		return;
+	}
+	struct woodland_output *output;
+	wl_list_for_each(output, &view->server->outputs, link) {
+		uint32_t bit = 1u << output->index;
+		if (changed & bit) {
+			struct surface_output_data odata = {
+				.output = output->wlr_output,
+				.enter = outputs & bit,
+			};
+			wlr_xdg_surface_for_each_surface(view->xdg_surface, surface_output_iterator, &odata);
+		}
+	}
+	view->outputs = outputs;
+	view->visible_outputs &= outputs;
+	// Nothing shows the view anymore, its frame callbacks come from the throttle timer
+	if (!outputs && view->mapped) {
+		view->throttled = true;
+		frame_throttle_arm(view->server);
+	}
+}
+
+/* Recomputes which outputs the view intersects, on map, move, resize and
+ * whenever the output layout changes.
+ */
+static void view_update_outputs(struct woodland_view *view) {
+	uint32_t outputs = 0;
+	if (view->mapped) {
+		struct wlr_surface *surface = view->xdg_surface->surface;
+		struct wlr_box box = {
+			.x = view->x,
+			.y = view->y,
+			.width = surface->current.width,
+			.height = surface->current.height,
+		};
+		struct woodland_output *output;
+		wl_list_for_each(output, &view->server->outputs, link) {
+			struct wlr_box intersection;
+			if (wlr_box_intersection(&intersection, &box, &output->layout_box)) {
+				outputs |= 1u << output->index;
+			}
+		}
+	}
+	view_set_outputs(view, outputs);
+	view_update_hit_box(view);
+}
+
+/* Moves the view so its committed geometry sits where the resize asked for,
+ * keeping the edges opposite to the grabbed ones in place when the client
+ * picked another size than the one configured.
+ */
+static void view_resize_place(struct woodland_view *view) {
+	struct wlr_box geo_box;
+	wlr_xdg_surface_get_geometry(view->xdg_surface, &geo_box);
+	struct wlr_box *box = &view->resize_box;
+	view_damage_whole(view);
+	if (view->resize_edges & WLR_EDGE_LEFT) {
+		view->x = box->x + box->width - geo_box.width - geo_box.x;
+	}
+	else {
+		view->x = box->x - geo_box.x;
+	}
+	if (view->resize_edges & WLR_EDGE_TOP) {
+		view->y = box->y + box->height - geo_box.height - geo_box.y;
+	}
+	else {
+		view->y = box->y - geo_box.y;
+	}
+	view_update_outputs(view);
+	view_damage_whole(view);
+}
+
+/* Asks the client for the geometry 'box' of an interactive resize. While it
+ * still works on the previous size the new one only replaces the pending one,
+ * the client is never sent more sizes than it draws.
+ */
+static void view_resize_request(struct woodland_view *view, const struct wlr_box *box,
+															uint32_t edges) {
+	if (view->resize_serial) {
+		if (view->resize_pending) {
+			view->server->resizes_coalesced++;
+		}
+		view->resize_pending = true;
+		view->resize_next = *box;
+		view->resize_next_edges = edges;
+		return;
+	}
+	view->resize_box = *box;
+	view->resize_edges = edges;
+	struct wlr_box geo_box;
+	wlr_xdg_surface_get_geometry(view->xdg_surface, &geo_box);
+	if (geo_box.width == box->width && geo_box.height == box->height) {
+		// Nothing for the client to draw, only the position may change
+		view_resize_place(view);
+		return;
+	}
+	view->server->resize_configures++;
+	view->resize_serial = wlr_xdg_toplevel_set_size(view->xdg_surface, box->width, box->height);
+	if (!view->resize_serial) {
+		view_resize_place(view);
+	}
+}
+
+/* A commit of the toplevel surface, ends the transaction once it acks the
+ * configure in flight or a later one, and sends the size that waited for it.
+ */
+static void view_resize_commit(struct woodland_view *view) {
+	uint32_t serial = view->xdg_surface->current.configure_serial;
+	if (!view->resize_serial || (int32_t)(serial - view->resize_serial) < 0) {
+		return;
+	}
+	view->resize_serial = 0;
+	view_resize_place(view);
+	if (view->resize_pending) {
+		view->resize_pending = false;
+		view_resize_request(view, &view->resize_next, view->resize_next_edges);
+	}
+}
+
+/* A commit that doesn't change the size only needs a new texture and source
+ * box in the render items of the surface, the rest of the lists stays valid.
+ */
+static void render_lists_update_surface(struct woodland_server *server,
+												struct wlr_surface *surface) {
+	struct woodland_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output->render_list_dirty) {
+			continue;
+		}
+		for (size_t i = 0; i < output->num_render_items; i++) {
+			struct render_item *item = &output->render_items[i];
+			if (item->surface != surface) {
+				continue;
+			}
+			item->texture = wlr_surface_get_texture(surface);
+			if (!item->texture) {
+				output->render_list_dirty = true;
+				break;
+			}
+			wlr_surface_get_buffer_source_box(surface, &item->src_box);
+		}
+	}
+}
+
+static void surface_handle_commit(struct wl_listener *listener, void *data) {
+	(void)data;
+	struct woodland_surface *wsurface = wl_container_of(listener, wsurface, commit);
+	struct woodland_server *server = wsurface->server;
+	struct surface_damage_data ddata = {
+		.server = server,
+		.target = wsurface->surface,
+	};
+	// Find where the surface is drawn, views first then layer surfaces
+	bool throttled = false;
+	struct woodland_view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (view->mapped) {
+			if (view->resize_serial && view->xdg_surface->surface == wsurface->surface) {
+				view_resize_commit(view);
+			}
+			ddata.x = view->x;
+			ddata.y = view->y;
+			ddata.layout = TREE_LAYOUT_SEED;
+			wlr_xdg_surface_for_each_surface(view->xdg_surface, damage_surface_iterator, &ddata);
+			if (ddata.found) {
+				if (ddata.layout != view->tree_layout) {
+					// Where the tree was, still in the hit box, and where it is now
+					view->tree_layout = ddata.layout;
+					damage_box(server, NULL, &view->hit.box);
+					view_damage_whole(view);
+				}
+				// The size may have changed, and with it the outputs the view is on
+				view_update_outputs(view);
+				throttled = view->throttled;
+				break;
+			}
+		}
+	}
+	if (!ddata.found) {
+		struct woodland_layer_view *layer_view;
+		wl_list_for_each(layer_view, &server->layer_surfaces, link) {
+			if (layer_view->mapped) {
+				ddata.output = layer_view->layer_surface->output;
+				ddata.x = layer_view->x;
+				ddata.y = layer_view->y;
+				ddata.layout = TREE_LAYOUT_SEED;
+				wlr_layer_surface_v1_for_each_surface(layer_view->layer_surface,
+												damage_surface_iterator, &ddata);
+				if (ddata.found) {
+					if (ddata.layout != layer_view->tree_layout) {
+						layer_view->tree_layout = ddata.layout;
+						damage_box(server, ddata.output, &layer_view->hit.box);
+						struct surface_damage_data whole = ddata;
+						whole.target = NULL;
+						whole.whole = true;
+						wlr_layer_surface_v1_for_each_surface(layer_view->layer_surface,
+												damage_surface_iterator, &whole);
+					}
+					layer_view_update_hit_box(layer_view);
+					break;
+				}
+			}
+		}
+	}
+	if (ddata.found) {
+		render_lists_update_surface(server, wsurface->surface);
+	}
+	latency_surface_commit(server->latency, wsurface->surface);
+	// Without damage the client may still wait for a frame callback, hidden
+	// and minimized views get theirs from the throttle timer instead
+	if (ddata.found && !throttled &&
+					!wl_list_empty(&wsurface->surface->current.frame_callback_list)) {
+		struct woodland_output *output;
+		wl_list_for_each(output, &server->outputs, link) {
+			output_schedule_frame(output);
 		}
-		token = strtok(NULL, ",");
-		current_index++;
 	}
+}
+
+static void surface_handle_destroy(struct wl_listener *listener, void *data) {
+	(void)data;
+	struct woodland_surface *wsurface = wl_container_of(listener, wsurface, destroy);
+	// The render lists must not keep pointing at it
+	render_lists_invalidate(wsurface->server);
+	latency_surface_destroy(wsurface->server->latency, wsurface->surface);
+	wl_list_remove(&wsurface->commit.link);
+	wl_list_remove(&wsurface->destroy.link);
+	free(wsurface);
+}
 
-	free(layouts_copy);
-	return layout_name;
+static void server_new_surface(struct wl_listener *listener, void *data) {
+	struct wlr_surface *surface = data;
+	struct woodland_server *server = wl_container_of(listener, server, new_surface);
+	struct woodland_surface *wsurface = calloc(1, sizeof(struct woodland_surface));
+	if (!wsurface) {
+		wlr_log(WLR_ERROR, "Error: Failed to allocate memory in 'server_new_surface'!");
+		return;
+	}
+	wsurface->server = server;
+	wsurface->surface = surface;
+	wsurface->commit.notify = surface_handle_commit;
+	wl_signal_add(&surface->events.commit, &wsurface->commit);
+	wsurface->destroy.notify = surface_handle_destroy;
+	wl_signal_add(&surface->events.destroy, &wsurface->destroy);
 }
 
 /* brightness control */
@@ -372,8 +973,9 @@ static void server_new_idle(struct wl_listener *listener, void *data) {
 		server->saved_brightness = get_current_brightness(server->brightness_path);
 		set_brightness(0, server->brightness_path);
 	}
-	// Stop rendering on idle timeout
+	// Stop rendering on idle timeout, one last frame clears the screen
 	server->should_render = false;
+	damage_whole(server);
 	wlr_log(WLR_INFO, "The system is idle now.");
 }
 
@@ -385,14 +987,13 @@ static void server_idle_resume(struct wl_listener *listener, void *data) {
 		set_brightness(server->saved_brightness, server->brightness_path);
 	}
 	// Resume rendering when resumed from idle (either a mouse move or keyboard activity)
-	server->render_full_stop = false;
 	server->should_render = true;
-	// Schedule a new frame for each output
-	// we need this in order to resume the rendering function 'output_frame'
 	struct woodland_output *output;
 	wl_list_for_each(output, &server->outputs, link) {
-		wlr_output_schedule_frame(output->wlr_output);
+		output->blanked = false;
 	}
+	// Damage every output, we need this in order to resume the rendering function 'output_frame'
+	damage_whole(server);
 	wlr_log(WLR_INFO, "The system resumed from idle.");
 }
 
@@ -406,8 +1007,6 @@ static void update_pan_offset(struct woodland_server *server,
 	if ((server->zoom_factor - 0.2) <= 1.0) {
 		server->pan_offset_x = 0;
 		server->pan_offset_y = 0;
-		server->background_matrix[2] = 0; // Reset background x offset
-		server->background_matrix[5] = 0; // Reset background y offset
 		return;
 	}
 	// Check if the mouse is near the left edge of the screen
@@ -497,78 +1096,38 @@ static void seat_start_drag(struct wl_listener *listener, void *data) {
 	// wl_signal_add(&drag->events.destroy, &server->seat->drag.events.destroy);
 }
 
-static void change_keyboard_layout(struct woodland_server *server,
-								   struct wlr_keyboard *keyboard,
-								   struct woodland_view *view) {
-	// Change keyboard layout per application
-	char *layouts = get_char_value_from_conf(server->config, "xkb_layouts");
-	if (!layouts) {
-		wlr_log(WLR_ERROR, "Error: Failed to get xkb_layouts from config.");
-		return;
-	}
-
-	char *layout_name = layout_name_from_index(view->keyboard_layout, layouts);
-	if (!layout_name) {
-		wlr_log(WLR_ERROR, "Error: Failed to get layout name for index %d.", view->keyboard_layout);
-		free(layouts);
-		return;
-	}
-
-	char *new_layout = updated_layouts(layout_name, layouts);
-	if (!new_layout) {
-		wlr_log(WLR_ERROR, "Error: Failed to update layouts.");
-		free(layout_name);
-		free(layouts);
+static void set_keyboard_layout(struct wlr_keyboard *keyboard, xkb_layout_index_t layout) {
+	if (!keyboard->xkb_state || keyboard->modifiers.group == layout) {
 		return;
 	}
+	// Emits the modifiers event, which forwards the new group to the client
+	wlr_keyboard_notify_modifiers(keyboard,
+								  keyboard->modifiers.depressed,
+								  keyboard->modifiers.latched,
+								  keyboard->modifiers.locked,
+								  layout);
+}
 
-	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-	if (!context) {
-		wlr_log(WLR_ERROR, "Error: Failed to create xkb_context.");
-		free(new_layout);
-		free(layout_name);
-		free(layouts);
-		return;
-	}
-
-	struct xkb_rule_names rules = {
-		.layout = new_layout,
-		.options = "grp:alt_shift_toggle"
-	};
-
-	struct xkb_keymap *keymap = xkb_keymap_new_from_names(context,
-														  &rules,
-														  XKB_KEYMAP_COMPILE_NO_FLAGS);
-	if (!keymap) {
-		wlr_log(WLR_ERROR, "Error: Failed to create xkb_keymap.");
-		xkb_context_unref(context);
-		free(new_layout);
-		free(layout_name);
-		free(layouts);
-		return;
-	}
-
-	// Update the keyboard's keymap and state
-	wlr_keyboard_set_keymap(keyboard, keymap);
-	xkb_keymap_unref(keymap);
-	xkb_context_unref(context);
-
-	if (layout_name) {
-		//printf("Layout at index %d: %s\n", view->keyboard_layout, layout_name);
-		free(layout_name);
-	}
-	else {
-		wlr_log(WLR_ERROR, "No layout found at index %d", view->keyboard_layout);
-	}
-
-	if (new_layout) {
-		free(new_layout);
-		new_layout = NULL;
-	}
-
-	if (layouts) {
-		free(layouts);
-		layouts = NULL;
+/* Every layout from xkb_layouts is a group of the same keymap, so switching the
+ * layout per application only changes the locked group of the keyboard state.
+ * No keymap is compiled here, this runs on every focus change.
+ */
+static void change_keyboard_layout(struct woodland_server *server,
+								   struct woodland_view *view) {
+	xkb_layout_index_t layout = view->keyboard_layout;
+	if (layout >= server->LayoutIndexes) {
+		wlr_log(WLR_ERROR, "No layout found at index %d", layout);
+		layout = 0;
+	}
+	// The keyboard group copies the group of its members, so switch those
+	struct woodland_keyboard *keyboard;
+	wl_list_for_each(keyboard, &server->keyboards, link) {
+		set_keyboard_layout(keyboard->device->keyboard, layout);
+	}
+	wl_list_for_each(keyboard, &server->virtual_keyboards, link) {
+		if (keyboard->device->keyboard->keymap == server->keymap) {
+			set_keyboard_layout(keyboard->device->keyboard, layout);
+		}
 	}
 }
 
@@ -585,7 +1144,7 @@ static void focus_view(struct woodland_view *view, struct wlr_surface *surface)
 	struct wlr_seat *seat = server->seat;
 	/* Get the previously focused surface */
 	struct wlr_surface *prev_surface = seat->keyboard_state.focused_surface;
-	/* Notify the surface that it has entered the output */
+	/* The output under the cursor, the view is only activated when there is one */
 	struct wlr_output *output = wlr_output_layout_output_at(server->output_layout,
 															server->cursor->x,
 															server->cursor->y);
@@ -597,12 +1156,10 @@ static void focus_view(struct woodland_view *view, struct wlr_surface *surface)
 	if (!keyboard) {
 		wlr_log(WLR_ERROR, "No keyboard found for seat. Trying to reassign a keyboard.");
 		
-		/* Forcefully reassign the first available keyboard */
+		/* Forcefully reassign the group of physical keyboards */
 		struct woodland_keyboard *new_keyboard = NULL;
-		struct woodland_keyboard *key;
-		wl_list_for_each(key, &server->keyboards, link) {
-			new_keyboard = key;
-			break;  // Pick the first available keyboard
+		if (!wl_list_empty(&server->keyboards)) {
+			new_keyboard = server->group_keyboard;
 		}
 		
 		if (new_keyboard) {
@@ -650,8 +1207,10 @@ static void focus_view(struct woodland_view *view, struct wlr_surface *surface)
 			wl_list_remove(&view->link);
 			wl_list_insert(&server->views, &view->link);
 		}
+		view->hit.stack = ++server->hit_stack;
+		view_damage_whole(view);
 		// Change keyboard layout per application
-		change_keyboard_layout(server, keyboard, view);
+		change_keyboard_layout(server, view);
 	}
 	else {
 		wlr_log(WLR_ERROR, "'view' is NULL in 'focus_view.");
@@ -678,7 +1237,7 @@ static void focus_view(struct woodland_view *view, struct wlr_surface *surface)
 								   keyboard->num_keycodes,
 								   &keyboard->modifiers);
 	if (output) {
-		wlr_surface_send_enter(view->xdg_surface->surface, output);
+		// wl_surface enter and leave follow the outputs the view is on, see 'view_update_outputs'
 		if (view->foreign_toplevel) {
 			wlr_foreign_toplevel_handle_v1_set_activated(view->foreign_toplevel, true);
 		}
@@ -727,11 +1286,13 @@ static void keyboard_handle_destroy(struct wl_listener *listener, void *data) {
 }
 
 static void keyboard_handle_modifiers(struct wl_listener *listener, void *data) {
-	struct wlr_keyboard_modifiers *modifiers = data;
-	if (!modifiers) {
-		wlr_log(WLR_ERROR, "Received NULL modifiers data.");
+	// The signal data is the wlr_keyboard, not its modifiers
+	struct wlr_keyboard *wlr_keyboard = data;
+	if (!wlr_keyboard) {
+		wlr_log(WLR_ERROR, "Received NULL keyboard data.");
 		return;
 	}
+	struct wlr_keyboard_modifiers *modifiers = &wlr_keyboard->modifiers;
 
 	// Log the received modifiers for debugging
 	///\wlr_log(WLR_INFO, "Modifiers updated: depressed=0x%x, latched=0x%x, locked=0x%x,
@@ -743,7 +1304,17 @@ static void keyboard_handle_modifiers(struct wl_listener *listener, void *data)
 	// Set the keyboard for the seat
 	struct woodland_keyboard *keyboard = wl_container_of(listener, keyboard, modifiers);
 	if (keyboard && keyboard->device) {
-		wlr_seat_set_keyboard(keyboard->server->seat, keyboard->device);
+		// Remember the layout (Alt+Shift toggle) of the focused application
+		if (!wl_list_empty(&keyboard->server->views) &&
+			keyboard->device->keyboard->keymap == keyboard->server->keymap) {
+			struct woodland_view *current_view = wl_container_of(keyboard->server->views.next,
+																 current_view,
+																 link);
+			current_view->keyboard_layout = modifiers->group;
+		}
+		if (wlr_seat_get_keyboard(keyboard->server->seat) != keyboard->device->keyboard) {
+			wlr_seat_set_keyboard(keyboard->server->seat, keyboard->device);
+		}
 		// Notify the seat with the updated modifiers
 		wlr_seat_keyboard_notify_modifiers(keyboard->server->seat,
 							&keyboard->device->keyboard->modifiers);
@@ -753,196 +1324,62 @@ static void keyboard_handle_modifiers(struct wl_listener *listener, void *data)
 	}
 }
 
-/* This function parses the config file (woodland.ini) and storing all
- * user defined keyboard shortcuts (keys) in a char array
- */
-static void keybindings_group_init(char *config, char *modifierName, char **keynames,
-																char **keycommands) {
-	FILE *file = fopen(config, "r");
-	if (!file) {
-		perror("Error opening file");
-		return;
-	}
-	char buffer[1024];
-	int keyIndex = 0;
-	while (fgets(buffer, sizeof(buffer), file)) {
-		// Remove trailing newline if present
-		buffer[strcspn(buffer, "\n")] = 0;
-
-		// Ignore comments and empty lines
-		if (buffer[0] == '#' || buffer[0] == '\0') {
-			continue;
-		}
-
-		// Check if the line starts with "binding_"
-		if (strncmp(buffer, "binding_", 8) == 0) {
-			char *equalPos = strchr(buffer, '=');
-			if (equalPos) {
-				equalPos++; // Move past the '='
-				while (*equalPos == ' ' || *equalPos == '\t') equalPos++; // Skip spaces/tabs
-
-				// Check if the modifier name matches
-				if (strstr(equalPos, modifierName) == equalPos) {
-					equalPos += strlen(modifierName);
-					while (*equalPos == ' ' || *equalPos == '\t') equalPos++; //Skip spaces/tabs
-
-					// Extract the keyname
-					char *keyname = equalPos;
-					keynames[keyIndex] = strdup(keyname);
-
-					// Get the next line for the command
-					if (fgets(buffer, sizeof(buffer), file)) {
-						buffer[strcspn(buffer, "\n")] = 0;
-						// Ignore comments and empty lines
-						if (buffer[0] == '#' || buffer[0] == '\0') {
-							continue;
-						}
-						if (strncmp(buffer, "command_", 8) == 0) {
-							equalPos = strchr(buffer, '=');
-							if (equalPos) {
-								equalPos++; // Move past the '='
-								// Skip spaces/tabs
-								while (*equalPos == ' ' || *equalPos == '\t') equalPos++;
-
-								// Extract the command
-								keycommands[keyIndex] = strdup(equalPos);
-								keyIndex++; // Increment after setting command
-							}
-						}
-					}
-				}
-			}
-		}
-	}
-	fclose(file);
-}
-
-static void process_keybindings(struct woodland_server *server, char *config, char *modName,
-																		xkb_keysym_t sym) {
-	char *keynames[1024] = { 0 };
-	char *keycommands[1024] = { 0 };
-
-	// Parsing config file, extracting all user defined XKB keys bound to specified mod
-	// Storing all the key names in 'keynames' and corresponding commands in 'keycommands' 
-	keybindings_group_init(config, modName, keynames, keycommands);
-
-	// Converting currently pressed key (sym parameter) into a key name
-	// 'keyname' contains the char representation of the currently pressed key
-	char hexCode[256];
-	snprintf(hexCode, sizeof(hexCode), "%#06x", sym);
-	char *keyname = xkb_keyname(hexCode);
-	// Checking if the currently pressed key 'keyname' is found in 'keynames' char array
-	for (int i = 0; keynames[i] != NULL; i++) {
-		// If currently pressed key 'keyname' is found in 'keynames'
-		// then execute the corresponding command from 'keycommands'
-		if (strcmp(keyname, keynames[i]) == 0) {
-			///fprintf(stderr, "Found shortcut (%s+%s)\n", modName, keynames[i]);
-			///fprintf(stderr, "Executing command: %s\n", keycommands[i]);
-			server->keybind_handled = true;
-			run_cmd(keycommands[i]);  // Assuming you have a function to execute the command
-			break;
-		}
-	}
-	// Free resources
-	for (int i = 0; keynames[i] != NULL; i++) {
-		free(keynames[i]);
-		keynames[i] = NULL;
-		free(keycommands[i]);
-		keycommands[i] = NULL;
-	}
-	if (keyname != NULL) {
-		free(keyname);
-		keyname = NULL;
-	}
-}
-
-static bool handle_keybinding_alt(struct woodland_server *server, xkb_keysym_t sym) {
-	// This function assumes Alt is held down.
-	// Get the current view and the next view
-	struct woodland_view *current_view = wl_container_of(server->views.next, current_view, link);
-	struct woodland_view *next_view = wl_container_of(current_view->link.next, next_view, link);
-	switch (sym) {
-	case XKB_KEY_Tab: // Alt+Tab cycle to the next view
-		if (wl_list_length(&server->views) < 2) {
-			break;
-		}
-		if (next_view) {
-			server->keybind_handled = true;
-			focus_view(next_view, next_view->xdg_surface->surface);
-			/* Move the previous view to the end of the list */
-			wl_list_remove(&current_view->link);
-			wl_list_insert(server->views.prev, &current_view->link);
-		}
-		else {
-			wlr_log(WLR_ERROR, "'next_view' is NULL in 'handle_keybinding_alt'");
-		}
-		break;
-	default:
-		// Executing user defined shortcuts from config file
-		process_keybindings(server, server->config, "WLR_MODIFIER_ALT", sym);
-		break;
-	}
-	return true;
-}
-
-static bool handle_keybinding_ctrl(struct woodland_server *server, xkb_keysym_t sym) {
-	(void)server;
-	// This function assumes Ctrl is held down.
-	// Executing user defined shortcuts from config file
-	process_keybindings(server, server->config, "WLR_MODIFIER_CTRL", sym);
-	return true;
-}
-
-static bool handle_keybinding_shift(struct woodland_server *server, xkb_keysym_t sym) {
-	(void)server;
-	// This function assumes Shift is held down.
-	// Executing user defined shortcuts from config file
-	process_keybindings(server, server->config, "WLR_MODIFIER_SHIFT", sym);
-	return true;
-}
-
-static bool handle_keybinding_super(struct woodland_server *server, xkb_keysym_t sym) {
+static void handle_keybinding(struct woodland_server *server, uint32_t modifiers,
+														xkb_keysym_t sym) {
 	/*
 	 * Here we handle compositor keybindings. This is when the compositor is
 	 * processing keys, rather than passing them on to the client for its own
-	 * processing.
-	 *
-	 * This function assumes Super is held down.
+	 * processing. Both the default shortcuts and the user defined ones from
+	 * woodland.ini are looked up in the precompiled keybindings table.
 	 */
+	const struct keybinding *binding = keybindings_lookup(server->keybindings, modifiers, sym);
+	if (!binding) {
+		return;
+	}
+	server->keybind_handled = true;
+	wlr_log(WLR_DEBUG, "Keybinding 0x%x+%s", binding->modifiers, xkb_keyname(sym));
 	// Get the current view and the next view
 	struct woodland_view *current_view = wl_container_of(server->views.next, current_view, link);
 	struct woodland_view *next_view = wl_container_of(current_view->link.next, next_view, link);
-	switch (sym) {
-	case XKB_KEY_Escape: // Super+Esc Log out from compositor
+	switch (binding->action) {
+	case KEYBINDING_ACTION_TERMINATE: // Super+Esc Log out from compositor
 		wl_display_terminate(server->wl_display);
 		break;
-	case XKB_KEY_x: // Super+x close current active window
+	case KEYBINDING_ACTION_CLOSE_VIEW: // Super+x close current active window
 		if (!wl_list_empty(&server->views)) {
 			wlr_xdg_toplevel_send_close(current_view->xdg_surface);
 		}
 		break;
-	default:
+	case KEYBINDING_ACTION_NEXT_VIEW: // Alt+Tab cycle to the next view
+		if (wl_list_length(&server->views) < 2) {
+			break;
+		}
+		focus_view(next_view, next_view->xdg_surface->surface);
+		/* Move the previous view to the end of the list */
+		wl_list_remove(&current_view->link);
+		wl_list_insert(server->views.prev, &current_view->link);
+		hit_stack_renumber(server);
+		// Views that were below it now cover parts of it
+		view_damage_whole(current_view);
+		break;
+	case KEYBINDING_ACTION_COMMAND:
 		// Executing user defined shortcuts from config file
-		process_keybindings(server, server->config, "WLR_MODIFIER_LOGO", sym);
+		launcher_spawn(server->launcher, binding->command);
+		break;
+	case KEYBINDING_ACTION_NONE:
 		break;
 	}
-	return true;
 }
 
-static void keyboard_handle_key(struct wl_listener *listener, void *data) {
-	// NULL checks for listener and data
-	if (!listener || !data) {
-		wlr_log(WLR_ERROR, "'listener' or 'data' is NULL in 'keyboard_handle_key'");
+static void keyboard_key(struct wl_listener *listener, void *data) {
+	// NULL check for data, 'keyboard_handle_key' checked the listener and server
+	if (!data) {
+		wlr_log(WLR_ERROR, "'data' is NULL in 'keyboard_key'");
 		return;
 	}
 	
 	struct wlr_event_keyboard_key *event = data;
 	struct woodland_keyboard *keyboard = wl_container_of(listener, keyboard, key);
-	// NULL check for keyboard and server
-	if (!keyboard || !keyboard->server) {
-		wlr_log(WLR_ERROR, "'keyboard' or 'server' is NULL in 'keyboard_handle_key'");
-		return;
-	}
 	
 	struct wlr_session *session = wlr_backend_get_session(keyboard->server->backend);
 
@@ -953,7 +1390,7 @@ static void keyboard_handle_key(struct wl_listener *listener, void *data) {
 	// Get a list of keysyms based on the keymap for this keyboard
 	int nsyms = xkb_state_key_get_syms(keyboard->device->keyboard->xkb_state, keycode, &syms);
 	if (nsyms < 1 || !syms) {
-		wlr_log(WLR_ERROR, "Failed to get keysyms in 'keyboard_handle_key'");
+		wlr_log(WLR_ERROR, "Failed to get keysyms in 'keyboard_key'");
 		return;
 	}
 	
@@ -961,43 +1398,27 @@ static void keyboard_handle_key(struct wl_listener *listener, void *data) {
 	keyboard->server->modifier = modifiers;
 
 	// Translate the key symbol code into a key name as defined in the header
-	char hexCode[256];
-	snprintf(hexCode, sizeof(hexCode), "%#06x", syms[0]);
-	char *keyname = xkb_keyname(hexCode);
+	const char *keyname = xkb_keyname(syms[0]);
 	if (!keyname) {
-		wlr_log(WLR_ERROR, "Failed to get keyname in 'keyboard_handle_key'");
+		wlr_log(WLR_ERROR, "Failed to get keyname in 'keyboard_key'");
 	}
 
 	keyboard->server->keybind_handled = false;
 
 	for (int i = 0; i < nsyms; i++) {
 		if (event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
-			// Change keyboard layout
-			if (syms[i] == XKB_KEY_ISO_Next_Group) {
-				struct woodland_view *current_view = wl_container_of(keyboard->server->views.next,
-																	 current_view,
-																	 link);
-				if (current_view && keyboard->server->seat->keyboard_state.keyboard->xkb_state) {
-					if (current_view->keyboard_layout >= (keyboard->server->LayoutIndexes - 1)) {
-						current_view->keyboard_layout = 0;
-					}
-					else {
-						current_view->keyboard_layout = current_view->keyboard_layout + 1;
-					}
-				}
-			}
 			// Multimedia keys support
-			else if (syms[i] == XKB_KEY_XF86AudioPlay || syms[i] == XKB_KEY_XF86AudioPause ||
+			if (syms[i] == XKB_KEY_XF86AudioPlay || syms[i] == XKB_KEY_XF86AudioPause ||
 				syms[i] == XKB_KEY_XF86AudioMute) {
-				run_cmd(keyboard->server->play_pause);
+				launcher_spawn(keyboard->server->launcher, keyboard->server->play_pause);
 				return;
 			}
 			else if (syms[i] == XKB_KEY_XF86AudioRaiseVolume) {
-				run_cmd(keyboard->server->volume_up);
+				launcher_spawn(keyboard->server->launcher, keyboard->server->volume_up);
 				return;
 			}
 			else if (syms[i] == XKB_KEY_XF86AudioLowerVolume) {
-				run_cmd(keyboard->server->volume_down);
+				launcher_spawn(keyboard->server->launcher, keyboard->server->volume_down);
 				return;
 			}
 			else if (syms[i] == XKB_KEY_XF86MonBrightnessUp) {
@@ -1009,7 +1430,7 @@ static void keyboard_handle_key(struct wl_listener *listener, void *data) {
 										keyboard->server->brightness_path);
 				}
 				else {
-					wlr_log(WLR_ERROR, "'brightness_path' is NULL in 'keyboard_handle_key'");
+					wlr_log(WLR_ERROR, "'brightness_path' is NULL in 'keyboard_key'");
 				}
 				return;
 			}
@@ -1022,7 +1443,7 @@ static void keyboard_handle_key(struct wl_listener *listener, void *data) {
 										keyboard->server->brightness_path);
 				}
 				else {
-					wlr_log(WLR_ERROR, "'brightness_path' is NULL in 'keyboard_handle_key'");
+					wlr_log(WLR_ERROR, "'brightness_path' is NULL in 'keyboard_key'");
 				}
 				return;
 			}
@@ -1039,39 +1460,26 @@ static void keyboard_handle_key(struct wl_listener *listener, void *data) {
 		if (syms[i] == XKB_KEY_Super_L || syms[i] == XKB_KEY_Super_R) {
 			keyboard->server->super_key_down = (event->state == WL_KEYBOARD_KEY_STATE_PRESSED);
 		}
-		// Handle compositor keybindings
-		else if (keyname) {
-			if ((modifiers & WLR_MODIFIER_ALT) && event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
-				handle_keybinding_alt(keyboard->server, syms[i]);
-			}
-			else if ((modifiers & WLR_MODIFIER_CTRL) && \
-					event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
-				handle_keybinding_ctrl(keyboard->server, syms[i]);
-			}
-			else if ((modifiers & WLR_MODIFIER_SHIFT) && \
-					event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
-				handle_keybinding_shift(keyboard->server, syms[i]);
-			}
-			else if ((modifiers & WLR_MODIFIER_LOGO) && \
-					event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
-				handle_keybinding_super(keyboard->server, syms[i]);
-			}
+		// Handle compositor keybindings, any combination of modifiers
+		else if (keyname && event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+			handle_keybinding(keyboard->server, modifiers, syms[i]);
 		}
 	}
 
-	// Clean up keyname memory
-	if (keyname) {
-		free(keyname);
-		keyname = NULL;
-	}
-
 	// Pass the key to the client if not handled by keybindings
 	if (!keyboard->server->keybind_handled) {
-		wlr_seat_set_keyboard(keyboard->server->seat, keyboard->device);
+		// Only switches when typing moves between the group and a virtual keyboard
+		if (wlr_seat_get_keyboard(keyboard->server->seat) != keyboard->device->keyboard) {
+			wlr_seat_set_keyboard(keyboard->server->seat, keyboard->device);
+		}
 		wlr_seat_keyboard_notify_key(keyboard->server->seat,
 									 event->time_msec,
 									 event->keycode,
 									 event->state);
+		if (event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+			latency_input(keyboard->server->latency, keyboard->device->name, LATENCY_KEY,
+						keyboard->server->seat->keyboard_state.focused_surface, event->time_msec);
+		}
 	}
 
 	// Send the keyboard activity event to idle manager
@@ -1079,66 +1487,80 @@ static void keyboard_handle_key(struct wl_listener *listener, void *data) {
 		wlr_idle_notify_activity(keyboard->server->idle, keyboard->server->seat);
 	}
 	else {
-		wlr_log(WLR_ERROR, "'idle' or 'seat' is NULL in 'keyboard_handle_key'");
+		wlr_log(WLR_ERROR, "'idle' or 'seat' is NULL in 'keyboard_key'");
 	}
 }
 
-static void server_new_keyboard(struct woodland_server *server, struct wlr_input_device *device) {
-	struct woodland_keyboard *keyboard = calloc(1, sizeof(struct woodland_keyboard));
-	if (!keyboard) {
-		wlr_log(WLR_ERROR, "Failed to allocate woodland_keyboard.");
+/* Timed, 'make bench' reports the distribution at exit */
+static void keyboard_handle_key(struct wl_listener *listener, void *data) {
+	if (!listener) {
+		wlr_log(WLR_ERROR, "'listener' is NULL in 'keyboard_handle_key'");
 		return;
 	}
-	keyboard->destroyed = false;
-	char *layouts = get_char_value_from_conf(server->config, "xkb_layouts");
-	if (!layouts) {
-		wlr_log(WLR_ERROR, "Error: Keyboard layouts could not be loaded from config\n");
-		free(keyboard);
+	struct woodland_keyboard *keyboard = wl_container_of(listener, keyboard, key);
+	if (!keyboard->server) {
+		wlr_log(WLR_ERROR, "'server' is NULL in 'keyboard_handle_key'");
 		return;
 	}
-	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-	if (!context) {
-		wlr_log(WLR_ERROR, "Failed to create XKB context.");
-		free(keyboard);
-		free(layouts);
-		return;
+	uint64_t start = timing_now_ns();
+	keyboard_key(listener, data);
+	histogram_add(&keyboard->server->key_time, timing_now_ns() - start);
+}
+
+/* All physical keyboards are merged into one wlr_keyboard_group, it is the
+ * keyboard of the seat and the only one whose key and modifier events we handle.
+ */
+static struct woodland_keyboard *server_new_keyboard_group(struct woodland_server *server) {
+	server->keyboard_group = wlr_keyboard_group_create();
+	if (!server->keyboard_group) {
+		wlr_log(WLR_ERROR, "Failed to create keyboard group.");
+		return NULL;
 	}
-	struct xkb_rule_names rules = {
-		.layout = layouts, // Specify multiple layouts separated by commas
-		.options = "grp:alt_shift_toggle" // Option to switch layout with Alt+Shift
-	};
-	struct xkb_keymap *keymap = xkb_keymap_new_from_names(context,
-														  &rules,
-														  XKB_KEYMAP_COMPILE_NO_FLAGS);
-	if (!keymap) {
-		wlr_log(WLR_ERROR, "Failed to create XKB keymap.");
-		xkb_context_unref(context);
-		free(keyboard);
-		free(layouts);
+	struct woodland_keyboard *keyboard = calloc(1, sizeof(struct woodland_keyboard));
+	if (!keyboard) {
+		wlr_log(WLR_ERROR, "Failed to allocate woodland_keyboard.");
+		return NULL;
+	}
+	keyboard->server = server;
+	keyboard->device = server->keyboard_group->input_device;
+	wlr_keyboard_set_keymap(keyboard->device->keyboard, server->keymap);
+	wlr_keyboard_set_repeat_info(keyboard->device->keyboard, 30, 300);
+	keyboard->key.notify = keyboard_handle_key;
+	wl_signal_add(&keyboard->device->keyboard->events.key, &keyboard->key);
+	keyboard->modifiers.notify = keyboard_handle_modifiers;
+	wl_signal_add(&keyboard->device->keyboard->events.modifiers, &keyboard->modifiers);
+	keyboard->destroy.notify = keyboard_handle_destroy;
+	wl_signal_add(&keyboard->device->keyboard->events.destroy, &keyboard->destroy);
+	// The group itself is not in the list of physical keyboards
+	wl_list_init(&keyboard->link);
+	return keyboard;
+}
+
+static void server_new_keyboard(struct woodland_server *server, struct wlr_input_device *device) {
+	struct woodland_keyboard *keyboard = calloc(1, sizeof(struct woodland_keyboard));
+	if (!keyboard) {
+		wlr_log(WLR_ERROR, "Failed to allocate woodland_keyboard.");
 		return;
 	}
+	keyboard->destroyed = false;
 	keyboard->server = server;
 	keyboard->device = device;
-	wlr_keyboard_set_keymap(device->keyboard, keymap);
+	// The keymap was compiled at startup, wlroots only takes a reference.
+	// Keymap and repeat info must match the group for the device to join it.
+	wlr_keyboard_set_keymap(device->keyboard, server->keymap);
 	wlr_keyboard_set_repeat_info(device->keyboard, 30, 300);
-	// Set up listeners for keyboard events
-	keyboard->key.notify = keyboard_handle_key;
-	wl_signal_add(&device->keyboard->events.key, &keyboard->key);
-	keyboard->modifiers.notify = keyboard_handle_modifiers;
-	wl_signal_add(&device->keyboard->events.modifiers, &keyboard->modifiers);
+	if (!wlr_keyboard_group_add_keyboard(server->keyboard_group, device->keyboard)) {
+		wlr_log(WLR_ERROR, "Failed to add keyboard to the keyboard group.");
+	}
+	// Key and modifier events arrive through the group keyboard
+	wl_list_init(&keyboard->key.link);
+	wl_list_init(&keyboard->modifiers.link);
 	keyboard->destroy.notify = keyboard_handle_destroy;
 	wl_signal_add(&device->keyboard->events.destroy, &keyboard->destroy);
 	// Set the keyboard for the seat
-	wlr_seat_set_keyboard(server->seat, device);
+	wlr_seat_set_keyboard(server->seat, server->group_keyboard->device);
 	// Add the keyboard to the list of keyboards
 	wl_list_insert(&server->keyboards, &keyboard->link);
-	// Clean up
-	xkb_keymap_unref(keymap);
-	xkb_context_unref(context);
-	free(layouts);
-	
-	keyboard->server->LayoutIndexes = xkb_keymap_num_layouts(
-								keyboard->server->seat->keyboard_state.keyboard->keymap);
 }
 
 static void server_new_pointer(struct woodland_server *server, struct wlr_input_device *device) {
@@ -1210,6 +1632,10 @@ static void virtual_keyboard_destroy_handler(struct wl_listener *listener, void
 	if (!wl_list_empty(&keyboard->destroy.link)) {
 		wl_list_remove(&keyboard->destroy.link);
 	}
+	if (wlr_seat_get_keyboard(keyboard->server->seat) == keyboard->device->keyboard) {
+		wlr_seat_set_keyboard(keyboard->server->seat, NULL);
+	}
+	wl_list_remove(&keyboard->link);
 
 	// Optionally reset the keyboard device if needed
 	///keyboard->device = NULL; // Uncomment if required
@@ -1233,7 +1659,7 @@ static void new_virtual_keyboard_handler(struct wl_listener *listener, void *dat
 
 	/* Create a new woodland_keyboard structure to represent the virtual keyboard. */
 	struct woodland_keyboard *keyboard = calloc(1, sizeof(struct woodland_keyboard));
-	if ((!virtual_keyboard) || (virtual_keyboard == NULL)) {
+	if (!keyboard) {
 		wlr_log(WLR_ERROR, "'keyboard' memory alloc failed in 'new_virtual_keyboard_handler'.");
 		return;
 	}
@@ -1241,22 +1667,9 @@ static void new_virtual_keyboard_handler(struct wl_listener *listener, void *dat
 	keyboard->server = server;
 	keyboard->device = &virtual_keyboard->input_device;
 
-	/* We need to prepare an XKB keymap and assign it to the keyboard. This
-	 * assumes the defaults (e.g. layout = "us"). */
-	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-	if ((!context) || (context == NULL)) {
-		wlr_log(WLR_ERROR, "'context' is NULL in 'new_virtual_keyboard_handler'.");
-		return;
-	}
-	struct xkb_keymap *keymap = xkb_keymap_new_from_names(context, NULL,
-																XKB_KEYMAP_COMPILE_NO_FLAGS);
-	if ((!keymap) || (keymap == NULL)) {
-		wlr_log(WLR_ERROR, "'keymap' is NULL in 'new_virtual_keyboard_handler'.");
-		return;
-	}
-
-	/* Dereference the keyboard pointer */
-	wlr_keyboard_set_keymap(keyboard->device->keyboard, keymap);
+	/* Until the client uploads its own keymap the virtual keyboard shares the
+	 * compiled keymap of the physical keyboards. */
+	wlr_keyboard_set_keymap(keyboard->device->keyboard, server->keymap);
 	wlr_keyboard_set_repeat_info(keyboard->device->keyboard, 30, 300);
 
 	/* Set up listeners for keyboard events. */
@@ -1269,12 +1682,73 @@ static void new_virtual_keyboard_handler(struct wl_listener *listener, void *dat
 	keyboard->destroy.notify = virtual_keyboard_destroy_handler;
 	wl_signal_add(&virtual_keyboard->events.destroy, &keyboard->destroy);
 
+	wl_list_insert(&server->virtual_keyboards, &keyboard->link);
 	wlr_seat_set_keyboard(server->seat, keyboard->device);
-	xkb_keymap_unref(keymap);
-	xkb_context_unref(context);
+	// Without a physical keyboard the seat didn't announce one yet
+	wlr_seat_set_capabilities(server->seat, server->seat->capabilities | WL_SEAT_CAPABILITY_KEYBOARD);
 	wlr_log(WLR_INFO, "Virtual keyboard initialized: %p", virtual_keyboard);
 }
 
+/* A virtual pointer (wayvnc, ydotool, the benchmark) moves the cursor like a mouse */
+static void new_virtual_pointer_handler(struct wl_listener *listener, void *data) {
+	struct wlr_virtual_pointer_v1_new_pointer_event *event = data;
+	struct woodland_server *server = wl_container_of(listener, server, new_virtual_pointer);
+	struct wlr_input_device *device = &event->new_pointer->input_device;
+	server_new_pointer(server, device);
+	if (event->suggested_output) {
+		wlr_cursor_map_input_to_output(server->cursor, device, event->suggested_output);
+	}
+	wlr_log(WLR_INFO, "Virtual pointer initialized: %p", event->new_pointer);
+}
+
+/* Cursor images: the cursor shows either a themed image or the surface of a
+ * client. Pointer motion asks for an image all the time, it is only handed to
+ * the cursor when it changes, wlroots then puts it on the hardware cursor
+ * plane of every output that has one and composites it into the frames of
+ * the others.
+ */
+static void cursor_set_image(struct woodland_server *server, const char *name) {
+	if (server->cursor_name && strcmp(server->cursor_name, name) == 0) {
+		server->cursor_images_kept++;
+		return;
+	}
+	wlr_xcursor_manager_set_cursor_image(server->cursor_mgr, name, server->cursor);
+	server->cursor_name = name;
+	server->cursor_image_sets++;
+}
+
+static void cursor_set_surface(struct woodland_server *server, struct wlr_surface *surface,
+													int32_t hotspot_x, int32_t hotspot_y) {
+	wlr_cursor_set_surface(server->cursor, surface, hotspot_x, hotspot_y);
+	server->cursor_name = NULL;
+	server->cursor_image_sets++;
+}
+
+/* The theme is loaded once per output scale, the manager keeps the images of
+ * every loaded scale and the cursor picks the one of the output it is on.
+ */
+static void cursor_load_scale(struct woodland_server *server, float scale) {
+	for (int i = 0; i < server->num_cursor_scales; i++) {
+		if (server->cursor_scales[i] == scale) {
+			return;
+		}
+	}
+	if (!wlr_xcursor_manager_load(server->cursor_mgr, scale)) {
+		wlr_log(WLR_ERROR, "Error: Failed to load the cursor theme at scale %.2f in "
+											"'cursor_load_scale'!", scale);
+		return;
+	}
+	if (server->num_cursor_scales < MAX_CURSOR_SCALES) {
+		server->cursor_scales[server->num_cursor_scales++] = scale;
+	}
+	// The image shown has to be set again to get its new size
+	const char *name = server->cursor_name;
+	if (name) {
+		server->cursor_name = NULL;
+		cursor_set_image(server, name);
+	}
+}
+
 static void seat_request_cursor(struct wl_listener *listener, void *data) {
 	/* This event is raised by the seat when a client provides a cursor image */
 	struct wlr_seat_pointer_request_set_cursor_event *event = data;
@@ -1291,10 +1765,7 @@ static void seat_request_cursor(struct wl_listener *listener, void *data) {
 		 * provided surface as the cursor image. It will set the hardware cursor
 		 * on the output that it's currently on and continue to do so as the
 		 * cursor moves between outputs. */
-		wlr_cursor_set_surface(server->cursor,
-							   event->surface,
-							   event->hotspot_x,
-							   event->hotspot_y);
+		cursor_set_surface(server, event->surface, event->hotspot_x, event->hotspot_y);
 	}
 }
 
@@ -1368,40 +1839,91 @@ static bool view_at(struct woodland_view *view, double lx, double ly, struct wlr
 	return false;
 }
 
-static struct woodland_view *desktop_view_at(struct woodland_server *server, double lx, double ly,
-										struct wlr_surface **surface, double *sx, double *sy) {
-	/* This iterates over all of our surfaces and attempts to find one under the
-	 * cursor. This relies on server->views being ordered from top-to-bottom.
-	 * If we have any layer shell applicaiton then we need to make sure it is
-	 * always rendered above other toplevels and not only its buffer but its
-	 * wlr_surface too.
+/* A layer surface is under the cursor, toplevels below it get no events */
+static void desktop_layer_hit(struct woodland_server *server) {
+	cursor_set_image(server, "left_ptr");
+	server->layer_view_found = true;
+}
+
+static struct woodland_view *desktop_view_hit(struct woodland_view *view) {
+	/* Sets explicit cursor theme instead of default xcursor theme
+	 * because default xcursor theme doesn't scale well
+	 * but only if no constraints are applied,
+	 * if not checking for constrains then it won't hide pointer in games.
 	 */
-	// First, check if at this coordinates underneath other toplevels there is any layer surface
-    struct woodland_layer_view *layer_view;
-    wl_list_for_each(layer_view, &server->layer_surfaces, link) {
-        if (view_layer_at(layer_view, lx, ly, surface, sx, sy)) {
-			/// If any layer surface found underneath any XDG toplevels then do nothing
-			wlr_xcursor_manager_set_cursor_image(layer_view->server->cursor_mgr,
-												 "left_ptr",
-												 layer_view->server->cursor);
-			server->layer_view_found = true;
-        	return NULL;
-        }
-    }
+	if (!view->server->active_pointer_constraint) {
+		cursor_set_image(view->server, "left_ptr");
+	}
+	return view;
+}
+
+/* Walks every layer surface and view, for points no hit grid covers */
+static struct woodland_view *desktop_view_at_linear(struct woodland_server *server,
+							double lx, double ly, struct wlr_surface **surface, double *sx, double *sy) {
+	struct woodland_layer_view *layer_view;
+	wl_list_for_each(layer_view, &server->layer_surfaces, link) {
+		if (view_layer_at(layer_view, lx, ly, surface, sx, sy)) {
+			desktop_layer_hit(server);
+			return NULL;
+		}
+	}
 	struct woodland_view *view;
 	wl_list_for_each(view, &server->views, link) {
 		if (view_at(view, lx, ly, surface, sx, sy)) {
-			/* Sets explicit cursor theme instead of default xcursor theme
-			 * because default xcursor theme doesn't scale well
-			 * but only if no constraints are applied,
-			 * if not checking for constrains then it won't hide pointer in games.
-			 */
-			if (!view->server->active_pointer_constraint) {
-            	wlr_xcursor_manager_set_cursor_image(view->server->cursor_mgr,
-            										 "left_ptr",
-            										 view->server->cursor);
-            }
-			return view;
+			return desktop_view_hit(view);
+		}
+	}
+	return NULL;
+}
+
+static struct woodland_view *desktop_view_at(struct woodland_server *server, double lx, double ly,
+										struct wlr_surface **surface, double *sx, double *sy) {
+	/* This finds the surface under the cursor. Layer surfaces come first, they
+	 * are always rendered above other toplevels and not only their buffer but
+	 * their wlr_surface too, then the views from top to bottom.
+	 * Only the candidates of the hit grid cell under the cursor are tested,
+	 * from the highest stacking order down until one accepts the point.
+	 */
+	struct hitgrid *grid = NULL;
+	struct woodland_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (wlr_box_contains_point(&output->layout_box, lx, ly)) {
+			grid = output->hitgrid;
+			break;
+		}
+	}
+	void **items;
+	size_t count;
+	if (!grid || !hitgrid_query(grid, lx, ly, &items, &count)) {
+		return desktop_view_at_linear(server, lx, ly, surface, sx, sy);
+	}
+	for (int layers = 1; layers >= 0; layers--) {
+		unsigned long below = ULONG_MAX;
+		while (true) {
+			struct hit_target *best = NULL;
+			for (size_t i = 0; i < count; i++) {
+				struct hit_target *target = items[i];
+				if ((target->layer_view != NULL) != layers || target->stack >= below ||
+											!wlr_box_contains_point(&target->box, lx, ly)) {
+					continue;
+				}
+				if (!best || target->stack > best->stack) {
+					best = target;
+				}
+			}
+			if (!best) {
+				break;
+			}
+			below = best->stack;
+			if (best->layer_view) {
+				if (view_layer_at(best->layer_view, lx, ly, surface, sx, sy)) {
+					desktop_layer_hit(server);
+					return NULL;
+				}
+			}
+			else if (view_at(best->view, lx, ly, surface, sx, sy)) {
+				return desktop_view_hit(best->view);
+			}
 		}
 	}
 	return NULL;
@@ -1414,10 +1936,13 @@ static void process_cursor_move(struct woodland_server *server, uint32_t time) {
 		return;
 	}
 	/* Move the grabbed view to the new position. */
+	view_damage_whole(server->grabbed_view);
 	server->grabbed_view->x = ((server->cursor->x + server->pan_offset_x) / \
 										server->zoom_factor) - server->grab_x;
 	server->grabbed_view->y = ((server->cursor->y + server->pan_offset_y) / \
 										server->zoom_factor) - server->grab_y;
+	view_update_outputs(server->grabbed_view);
+	view_damage_whole(server->grabbed_view);
 }
 
 static void process_cursor_resize(struct woodland_server *server, uint32_t time) {
@@ -1427,9 +1952,8 @@ static void process_cursor_resize(struct woodland_server *server, uint32_t time)
 	 * on one or two axes, but can also move the view if you resize from the top
 	 * or left edges (or top-left corner).
 	 *
-	 * Note the original author took some shortcuts here. In a more fleshed-out compositor,
-	 * you'd wait for the client to prepare a buffer at the new size, then
-	 * commit any movement that was prepared.
+	 * The movement waits for the client to commit a buffer at the new size,
+	 * see 'view_resize_request'.
 	 */
 	if (!server) {
 		wlr_log(WLR_ERROR, "Error: 'server' is NULL in 'process_cursor_resize'!");
@@ -1473,16 +1997,16 @@ static void process_cursor_resize(struct woodland_server *server, uint32_t time)
 			new_right = new_left + 1;
 		}
 	}
-	struct wlr_box geo_box;
-	wlr_xdg_surface_get_geometry(view->xdg_surface, &geo_box);
-	view->x = new_left - geo_box.x;
-	view->y = new_top - geo_box.y;
-	int new_width = new_right - new_left;
-	int new_height = new_bottom - new_top;
-	wlr_xdg_toplevel_set_size(view->xdg_surface, new_width, new_height);
+	struct wlr_box box = {
+		.x = new_left,
+		.y = new_top,
+		.width = new_right - new_left,
+		.height = new_bottom - new_top,
+	};
+	view_resize_request(view, &box, server->resize_edges);
 }
 
-static void process_cursor_motion(struct woodland_server *server, uint32_t time) {
+static void cursor_motion_update(struct woodland_server *server, uint32_t time) {
 	// If the cursor mode is set to move, process the cursor move and return.
 	if (server->cursor_mode == WOODLAND_CURSOR_MOVE) {
 		process_cursor_move(server, time);
@@ -1518,18 +2042,9 @@ static void process_cursor_motion(struct woodland_server *server, uint32_t time)
 	// Variables for storing surface-local coordinates
 	double sx;
 	double sy;
-	// Try to find a regular view under the cursor
-	struct woodland_view *view = desktop_view_at(server, cursor_x, cursor_y, &surface, &sx, &sy);
-	if (!view && !server->layer_view_found) {
-		// No surface found, log an error and reset layer view flag
-		server->layer_view_found = false;
-	}
-	else if (server->layer_view_found) {
-		server->layer_view_found = false;
-	}
-	else {
-		view_at(view, cursor_x, cursor_y, &surface, &sx, &sy);
-	}
+	// Find the view or layer surface under the cursor, it fills in 'surface'
+	desktop_view_at(server, cursor_x, cursor_y, &surface, &sx, &sy);
+	server->layer_view_found = false;
 
 	// Get the seat (input device)
 	struct wlr_seat *seat = server->seat;
@@ -1559,8 +2074,77 @@ static void process_cursor_motion(struct woodland_server *server, uint32_t time)
 		wlr_idle_notify_activity(server->idle, server->seat);
 	}
 	else {
-		wlr_log(WLR_ERROR, "Error: 'idle' is NULL in 'process_cursor_motion'");
+		wlr_log(WLR_ERROR, "Error: 'idle' is NULL in 'cursor_motion_update'");
+	}
+}
+
+static void process_cursor_motion(struct woodland_server *server, uint32_t time) {
+	uint64_t start = timing_now_ns();
+	cursor_motion_update(server, time);
+	histogram_add(&server->motion_time, timing_now_ns() - start);
+}
+
+/* Hit-testing, seat motion, idle and pan run once for every motion event that
+ * reached the cursor since the last time: the cursor itself moves right away,
+ * the rest waits for the next frame of the output under it. Anything that needs
+ * the pointer focus to be current calls this first.
+ */
+static void cursor_motion_flush(struct woodland_server *server) {
+	if (!server->motion_pending) {
+		return;
+	}
+	server->motion_pending = false;
+	process_cursor_motion(server, server->motion_time_msec);
+	// The client under the cursor gets the motion now, unless a grab keeps it
+	if (server->cursor_mode == WOODLAND_CURSOR_PASSTHROUGH) {
+		latency_input(server->latency, server->motion_device, LATENCY_MOTION,
+					server->seat->pointer_state.focused_surface, server->motion_time_msec);
+	}
+	if (server->motion_frame_pending) {
+		server->motion_frame_pending = false;
+		wlr_seat_pointer_notify_frame(server->seat);
+	}
+	if (!server->motion_pan_pending) {
+		return;
+	}
+	server->motion_pan_pending = false;
+	// Update pan offset based on the current cursor position
+	struct wlr_output *output = wlr_output_layout_output_at(server->output_layout,
+															server->cursor->x,
+															server->cursor->y);
+	if ((!output) || (output == NULL)) {
+		wlr_log(WLR_ERROR, "Error: 'output' is NULL in 'cursor_motion_flush'.");
+		return;
+	}
+	double pan_offset_x = server->pan_offset_x;
+	double pan_offset_y = server->pan_offset_y;
+	update_pan_offset(server, server->cursor->x, server->cursor->y, output->width, output->height);
+	if (pan_offset_x != server->pan_offset_x || pan_offset_y != server->pan_offset_y) {
+		damage_whole(server);
+	}
+}
+
+static void cursor_motion_defer(struct woodland_server *server, struct wlr_input_device *device,
+															uint32_t time, bool pan) {
+	server->motion_time_msec = time;
+	snprintf(server->motion_device, sizeof(server->motion_device), "%s",
+											device->name ? device->name : "unknown");
+	server->motion_pan_pending |= pan;
+	if (server->motion_pending) {
+		server->motions_coalesced++;
+		return;
 	}
+	server->motion_pending = true;
+	struct woodland_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		if (output->wlr_output->enabled &&
+				wlr_box_contains_point(&output->layout_box, server->cursor->x, server->cursor->y)) {
+			output_schedule_frame(output);
+			return;
+		}
+	}
+	// No output will show a frame, nothing to wait for
+	cursor_motion_flush(server);
 }
 
 static void apply_constraint(struct woodland_server *server,
@@ -1622,6 +2206,7 @@ static void server_cursor_motion(struct wl_listener *listener, void *data) {
 														event->delta_y,
 														event->unaccel_dx,
 														event->unaccel_dy);
+	server->motion_frame_relative = true;
 
 	// Apply constraints to keep mouse inside given box (e.g. in games)
 	apply_constraint(server, event->device, current_view, &event->delta_x, &event->delta_y);
@@ -1633,18 +2218,8 @@ static void server_cursor_motion(struct wl_listener *listener, void *data) {
 	 * the cursor around without any input. */
 	wlr_cursor_move(server->cursor, event->device, event->delta_x, event->delta_y);
 
-	// Process cursor motion (e.g., for updating focus, triggering actions, etc.)
-	process_cursor_motion(server, event->time_msec);
-
-	// Update pan offset based on the current cursor position
-	struct wlr_output *output = wlr_output_layout_output_at(server->output_layout,
-															server->cursor->x,
-															server->cursor->y);
-	if ((!output) || (output == NULL)) {
-		wlr_log(WLR_ERROR, "Error: 'output' is NULL in 'server_cursor_motion'.");
-		return;
-	}
-	update_pan_offset(server, server->cursor->x, server->cursor->y, output->width, output->height);
+	// Focus, actions and panning follow once per frame, see 'cursor_motion_flush'
+	cursor_motion_defer(server, event->device, event->time_msec, true);
 }
 
 static void server_cursor_motion_absolute(struct wl_listener *listener, void *data) {
@@ -1659,7 +2234,7 @@ static void server_cursor_motion_absolute(struct wl_listener *listener, void *da
 		return;
 	}
 	wlr_cursor_warp_absolute(server->cursor, event->device, event->x, event->y);
-	process_cursor_motion(server, event->time_msec);
+	cursor_motion_defer(server, event->device, event->time_msec, false);
 }
 
 /* Pointer constraints */
@@ -1703,6 +2278,8 @@ static void server_cursor_button(struct wl_listener *listener, void *data) {
 		wlr_log(WLR_ERROR, "Error: 'server' is NULL in 'server_cursor_button'!");
 		return;
 	}
+	// The button goes to the surface under the cursor now, not at the last frame
+	cursor_motion_flush(server);
 
 	// Adjust cursor coordinates by the scaling factor
 	double cursor_x = (server->cursor->x + server->pan_offset_x) / server->zoom_factor;
@@ -1710,6 +2287,10 @@ static void server_cursor_button(struct wl_listener *listener, void *data) {
 
 	// Notify the seat of the button event
 	wlr_seat_pointer_notify_button(server->seat, event->time_msec, event->button, event->state);
+	if (event->state == WLR_BUTTON_PRESSED) {
+		latency_input(server->latency, event->device->name, LATENCY_BUTTON,
+					server->seat->pointer_state.focused_surface, event->time_msec);
+	}
 
 	if (event->state == WLR_BUTTON_RELEASED) {
 		// Reset cursor mode and grabbed view on button release
@@ -1718,28 +2299,12 @@ static void server_cursor_button(struct wl_listener *listener, void *data) {
 		return;
 	}
 
-	// Check if any layer surface is under the cursor
-	struct woodland_layer_view *layer_view;
-	wl_list_for_each(layer_view, &server->layer_surfaces, link) {
-		if (layer_view->mapped) {
-			surface = wlr_layer_surface_v1_surface_at(layer_view->layer_surface,
-													  cursor_x,
-													  cursor_y,
-													  &sx,
-													  &sy);
-			if (surface) {
-				break;
-			}
-		}
-	}
-
-	// If a surface is found under the cursor, focus it and return
-	if (surface) {
+	// Check if a view is under the cursor, layer surfaces above it keep the click
+	struct woodland_view *view = desktop_view_at(server, cursor_x, cursor_y, &surface, &sx, &sy);
+	if (server->layer_view_found) {
+		server->layer_view_found = false;
 		return;
 	}
-
-	// Check if a view is under the cursor
-	struct woodland_view *view = desktop_view_at(server, cursor_x, cursor_y, &surface, &sx, &sy);
 	if (view && surface) {
 		// Focus the view
 		focus_view(view, surface);
@@ -1768,6 +2333,7 @@ static void server_cursor_axis(struct wl_listener *listener, void *data) {
 		wlr_log(WLR_ERROR, "Error: 'server' is NULL in 'server_cursor_axis'!");
 		return;
 	}
+	cursor_motion_flush(server);
 
 	struct wlr_output *output = wlr_output_layout_output_at(server->output_layout,
 															server->cursor->x,
@@ -1807,17 +2373,7 @@ static void server_cursor_axis(struct wl_listener *listener, void *data) {
 						server->zoom_factor = 1.0;
 						server->pan_offset_x = 0;
 						server->pan_offset_y = 0;
-						server->background_matrix[2] = 0; // Reset background x offset
-						server->background_matrix[5] = 0; // Reset background y offset
-						// Scaling the matrix for background image	// Begin rendering
-						wlr_matrix_project_box(server->background_matrix, &(struct wlr_box){
-																		.x = 0,
-																		.y = 0,
-																		.width = output->width,
-																		.height = output->height},
-																		WL_OUTPUT_TRANSFORM_NORMAL,
-																		0.0,
-																		output->transform_matrix);
+						damage_whole(server);
 					}
 					else if (server->zoom_factor > 1.0) {
 						// Decrease zooming factor
@@ -1825,6 +2381,7 @@ static void server_cursor_axis(struct wl_listener *listener, void *data) {
 						// Keeping zooming area centered
 						server->pan_offset_x = server->cursor->x * (server->zoom_factor - 1);
 						server->pan_offset_y = server->cursor->y * (server->zoom_factor - 1);
+						damage_whole(server);
 					}
 				}
 			}
@@ -1844,6 +2401,7 @@ static void server_cursor_axis(struct wl_listener *listener, void *data) {
 					// Keeping zooming area centered
 					server->pan_offset_x = server->cursor->x * (server->zoom_factor - 1);
 					server->pan_offset_y = server->cursor->y * (server->zoom_factor - 1);
+					damage_whole(server);
 				}
 			}
 			break;
@@ -1860,10 +2418,6 @@ static void server_cursor_axis(struct wl_listener *listener, void *data) {
 	// If a surface is under the cursor, notify the seat of the axis event
 	wlr_seat_pointer_notify_axis(server->seat, event->time_msec, event->orientation,
 	                        		     delta, event->delta_discrete, event->source);
-	// Commit the rendered output
-	if (!wlr_output_commit(output)) {
-		wlr_log(WLR_ERROR, "Failed to commit output");
-	}
 }
 
 static void server_cursor_frame(struct wl_listener *listener, void *data) {
@@ -1877,6 +2431,17 @@ static void server_cursor_frame(struct wl_listener *listener, void *data) {
 		wlr_log(WLR_ERROR, "Error: 'server' is NULL in 'server_cursor_frame'!");
 		return;
 	}
+	bool relative = server->motion_frame_relative;
+	server->motion_frame_relative = false;
+	// The frame follows the deferred motion it belongs to
+	if (server->motion_pending) {
+		server->motion_frame_pending = true;
+		// Relative motion was sent right away, it can't wait for another frame to merge it
+		if (relative) {
+			wlr_seat_pointer_notify_frame(server->seat);
+		}
+		return;
+	}
 	/* Notify the client with pointer focus of the frame event. */
 	wlr_seat_pointer_notify_frame(server->seat);
 }
@@ -1886,220 +2451,929 @@ static void server_cursor_frame(struct wl_listener *listener, void *data) {
 struct render_data {
 	struct timespec *when;
 	struct wlr_output *output;
-	struct woodland_view *view;
 	struct wlr_renderer *renderer;
-	struct woodland_layer_view *lview;
+	pixman_region32_t *damage;	// what needs to be repainted, output-local coordinates
 };
 
-static void render_surface(struct wlr_surface *surface, int sx, int sy, void *data) {
-	/* This function is called for every surface that needs to be rendered. */
-	if ((!surface) || (surface ==  NULL)) {
-		wlr_log(WLR_ERROR, "Error: 'surface' is NULL in 'render_surface'!");
-		return;
+/* Restricts rendering to a damaged rectangle, the scissor box is in buffer
+ * coordinates so the output transform is undone first.
+ */
+static void scissor_output(struct wlr_renderer *renderer, struct wlr_output *output,
+															pixman_box32_t *rect) {
+	struct wlr_box box = {
+		.x = rect->x1,
+		.y = rect->y1,
+		.width = rect->x2 - rect->x1,
+		.height = rect->y2 - rect->y1,
+	};
+	int output_width, output_height;
+	wlr_output_transformed_resolution(output, &output_width, &output_height);
+	enum wl_output_transform transform = wlr_output_transform_invert(output->transform);
+	wlr_box_transform(&box, &box, transform, output_width, output_height);
+	wlr_renderer_scissor(renderer, &box);
+}
+
+/* Draws the texture once per rectangle of 'region', the part of it that is
+ * damaged and not hidden by opaque surfaces above.
+ */
+static void render_texture(struct render_data *rdata, struct wlr_texture *texture,
+						const struct wlr_fbox *src_box, pixman_region32_t *region,
+											const float matrix[static 9], float alpha) {
+	int num_rects;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &num_rects);
+	for (int i = 0; i < num_rects; i++) {
+		scissor_output(rdata->renderer, rdata->output, &rects[i]);
+		wlr_render_subtexture_with_matrix(rdata->renderer, texture, src_box, matrix, alpha);
 	}
-	struct render_data *rdata = data;
-	if ((!rdata) || (rdata == NULL)) {
-		wlr_log(WLR_ERROR, "Error: 'rdata' is NULL in 'render_surface'!");
-		return;
+}
+
+static void send_frame_done_iterator(struct wlr_surface *surface, int sx, int sy, void *data) {
+	(void)sx;
+	(void)sy;
+	wlr_surface_send_frame_done(surface, data);
+}
+
+/* Nothing was repainted, but clients waiting for a frame callback may go on */
+static void send_frame_done(struct woodland_server *server, struct timespec *when) {
+	struct woodland_view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (view->mapped && !view->throttled) {
+			wlr_xdg_surface_for_each_surface(view->xdg_surface, send_frame_done_iterator, when);
+		}
 	}
-	struct woodland_view *view = rdata->view;
-	if ((!view) || (view == NULL)) {
-		wlr_log(WLR_ERROR, "Error: 'view' is NULL in 'render_surface'!");
-		return;
+	struct woodland_layer_view *layer_view;
+	wl_list_for_each(layer_view, &server->layer_surfaces, link) {
+		if (layer_view->mapped) {
+			wlr_layer_surface_v1_for_each_surface(layer_view->layer_surface,
+												send_frame_done_iterator, when);
+		}
 	}
-	struct wlr_output *output = rdata->output;
-	if ((!output) || (output == NULL)) {
-		wlr_log(WLR_ERROR, "Error: 'output' is NULL in 'render_surface'!");
-		return;
+}
+
+/* Sends the frame callbacks hidden and minimized views are waiting for, at a
+ * rate low enough that clients nobody sees stop rendering but don't hang.
+ */
+static int frame_throttle_tick(void *data) {
+	struct woodland_server *server = data;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	server->frame_throttle_armed = false;
+	bool pending = false;
+	struct woodland_view *view;
+	wl_list_for_each(view, &server->views, link) {
+		if (view->mapped && view->throttled) {
+			wlr_xdg_surface_for_each_surface(view->xdg_surface, send_frame_done_iterator, &now);
+			view->frames_throttled++;
+			pending = true;
+		}
+	}
+	wl_list_for_each(view, &server->minimized_views, link) {
+		wlr_xdg_surface_for_each_surface(view->xdg_surface, send_frame_done_iterator, &now);
+		view->frames_throttled++;
+		pending = true;
 	}
+	if (pending) {
+		server->frame_throttle_armed = true;
+		wl_event_source_timer_update(server->frame_throttle_timer, FRAME_THROTTLE_INTERVAL_MS);
+	}
+	return 0;
+}
+
+/* Position of the view or layer surface whose surfaces are being collected */
+struct render_list_data {
+	struct woodland_output *output;
+	struct woodland_view *view;
+	int x;
+	int y;
+	bool is_layer;
+};
 
-	/* We first obtain a wlr_texture, which is a GPU resource. wlroots
-	 * automatically handles negotiating these with the client. The underlying
-	 * resource could be an opaque handle passed from the client, or the client
-	 * could have sent a pixel buffer which we copied to the GPU, or a few other
-	 * means. You don't have to worry about this, wlroots takes care of it. */
+static void render_list_add_iterator(struct wlr_surface *surface, int sx, int sy, void *data) {
+	struct render_list_data *ldata = data;
+	struct woodland_output *output = ldata->output;
+	/* The wlr_texture is a GPU resource. wlroots automatically handles
+	 * negotiating these with the client, the underlying resource could be an
+	 * opaque handle passed from the client, or a pixel buffer which was copied
+	 * to the GPU. A surface without one has nothing to show yet. */
 	struct wlr_texture *texture = wlr_surface_get_texture(surface);
-	if ((!texture) || (texture == NULL)) {
-		wlr_log(WLR_ERROR, "Error: 'texture' is NULL in 'render_surface'!");
+	if (!texture) {
 		return;
 	}
-
-	/* The view has a position in layout coordinates. If you have two displays,
-	 * one next to the other, both 1080p, a view on the rightmost display might
-	 * have layout coordinates of 2000,100. We need to translate that to
-	 * output-local coordinates, or (2000 - 1920).
-	 * We also have to apply the scale factor for HiDPI outputs. This is only
-	 * part of the puzzle, TinyWL does not fully support HiDPI.
-	 */
-	struct wlr_box box;
-	box.x = view->x + sx;
-	box.y = view->y + sy;
-	box.width = surface->pending.width;
-	box.height = surface->pending.height;
-	/*
-	 * Those familiar with OpenGL are also familiar with the role of matrices
-	 * in graphics programming. We need to prepare a matrix to render the view
-	 * with. wlr_matrix_project_box is a helper which takes a box with a desired
-	 * x, y coordinates, width and height, and an output geometry, then
-	 * prepares an orthographic projection and multiplies the necessary
-	 * transforms to produce a model-view-projection matrix.
-	 *
-	 * Naturally you can do this any way you like, for example to make a 3D
-	 * compositor.
+	if (output->num_render_items == output->cap_render_items) {
+		size_t cap = output->cap_render_items ? output->cap_render_items * 2 : 32;
+		struct render_item *items = realloc(output->render_items, cap * sizeof(struct render_item));
+		if (!items) {
+			wlr_log(WLR_ERROR, "Error: Failed to allocate memory in 'render_list_add_iterator'!");
+			return;
+		}
+		output->render_items = items;
+		output->cap_render_items = cap;
+	}
+	struct render_item *item = &output->render_items[output->num_render_items++];
+	item->surface = surface;
+	item->view = ldata->view;
+	item->texture = texture;
+	item->alpha = 1.0f;
+	item->box.x = ldata->x + sx;
+	item->box.y = ldata->y + sy;
+	// Views are sized by their pending state, layer surfaces by the committed one
+	item->box.width = ldata->is_layer ? surface->current.width : surface->pending.width;
+	item->box.height = ldata->is_layer ? surface->current.height : surface->pending.height;
+	/* If use 'wlr_render_texture_with_matrix' then chromium based browsers like brave
+	 * have glitches they can't properly use viewporter and can't scale properly,
+	 * that's why the source box is always passed to 'wlr_render_subtexture_with_matrix'.
 	 */
-	wlr_matrix_project_box(view->server->matrix,
-						   &box,
+	wlr_surface_get_buffer_source_box(surface, &item->src_box);
+	/* wlr_matrix_project_box takes a box with a desired x, y coordinates, width
+	 * and height, and an output geometry, then prepares an orthographic
+	 * projection and multiplies the necessary transforms to produce a
+	 * model-view-projection matrix. */
+	wlr_matrix_project_box(item->matrix,
+						   &item->box,
 						   WL_OUTPUT_TRANSFORM_NORMAL,
 						   0.0,
-						   output->transform_matrix);
-	/* This takes our matrix, the texture, and an alpha, and performs the actual
-	 * rendering on the GPU.
-	 * If use 'wlr_render_texture_with_matrix' then chromium based browsers like brave
-	 * have glitches they can't properly use viewporter and can't scale properly,
-	 * that's why it's better to use 'wlr_render_subtexture_with_matrix'.
-	 */
-	struct wlr_fbox fbox;
-	wlr_surface_get_buffer_source_box(surface, &fbox);
-	wlr_render_subtexture_with_matrix(rdata->renderer, texture, &fbox, view->server->matrix, 1);
-	///wlr_render_texture_with_matrix(rdata->renderer, texture, view->server->matrix, 1);
+						   output->wlr_output->transform_matrix);
+	item->occluded = false;
+}
+
+/* Collects every surface that may be drawn on the output, bottom to top: the
+ * views on it in reverse focus order, then its layer surfaces above them. The
+ * list is only rebuilt when it was invalidated, see 'render_lists_invalidate'.
+ */
+static void render_list_build(struct woodland_output *output) {
+	struct woodland_server *server = output->server;
+	output->num_render_items = 0;
+	output->render_list_dirty = false;
+	output->render_list_builds++;
+	struct render_list_data ldata = {
+		.output = output,
+	};
+	// Only the views on this output, translated to output-local coordinates
+	uint32_t bit = 1u << output->index;
+	struct woodland_view *view;
+	wl_list_for_each_reverse(view, &server->views, link) {
+		if (view->mapped && (view->outputs & bit)) {
+			ldata.view = view;
+			ldata.x = view->x - output->layout_box.x;
+			ldata.y = view->y - output->layout_box.y;
+			wlr_xdg_surface_for_each_surface(view->xdg_surface, render_list_add_iterator, &ldata);
+		}
+	}
+	// Layer surfaces are arranged on their own output
+	ldata.view = NULL;
+	ldata.is_layer = true;
+	struct woodland_layer_view *layer_view;
+	wl_list_for_each_reverse(layer_view, &server->layer_surfaces, link) {
+		if (layer_view->mapped && layer_view->layer_surface->output == output->wlr_output) {
+			ldata.x = layer_view->x;
+			ldata.y = layer_view->y;
+			wlr_layer_surface_v1_for_each_surface(layer_view->layer_surface,
+												render_list_add_iterator, &ldata);
+		}
+	}
+}
+
+/* Walks the render list top to bottom and computes what is left visible of
+ * each surface once the opaque regions above it are removed. Surfaces with
+ * nothing left are marked occluded and won't be drawn, a view none of whose
+ * surfaces is on screen loses the output's bit in 'visible_outputs'. 'covered'
+ * receives the union of all opaque regions, the background is only drawn
+ * outside of it.
+ */
+static void render_list_cull(struct woodland_output *output, struct render_data *rdata,
+															pixman_region32_t *covered) {
+	int width, height;
+	wlr_output_transformed_resolution(output->wlr_output, &width, &height);
+	uint32_t bit = 1u << output->index;
+	for (size_t i = 0; i < output->num_render_items; i++) {
+		if (output->render_items[i].view) {
+			output->render_items[i].view->visible_outputs &= ~bit;
+		}
+	}
+	for (size_t i = output->num_render_items; i-- > 0;) {
+		struct render_item *item = &output->render_items[i];
+		item->occluded = false;
+		pixman_region32_init_rect(&item->visible, item->box.x, item->box.y,
+												item->box.width, item->box.height);
+		pixman_region32_subtract(&item->visible, &item->visible, covered);
+		pixman_region32_intersect_rect(&item->visible, &item->visible, 0, 0, width, height);
+		if (item->view && pixman_region32_not_empty(&item->visible)) {
+			item->view->visible_outputs |= bit;
+		}
+		/* Everything opaque covers what is below, damaged or not, so the
+		 * visibility of the views doesn't depend on what this frame repaints.
+		 * The opaque region is surface-local and may exceed the surface. */
+		pixman_region32_t opaque;
+		pixman_region32_init(&opaque);
+		pixman_region32_copy(&opaque, &item->surface->opaque_region);
+		pixman_region32_translate(&opaque, item->box.x, item->box.y);
+		pixman_region32_intersect_rect(&opaque, &opaque, item->box.x, item->box.y,
+												item->box.width, item->box.height);
+		pixman_region32_union(covered, covered, &opaque);
+		pixman_region32_fini(&opaque);
+		// Only the damaged part is drawn
+		pixman_region32_intersect(&item->visible, &item->visible, rdata->damage);
+		if (!pixman_region32_not_empty(&item->visible)) {
+			item->occluded = true;
+			output->surfaces_culled++;
+		}
+	}
+}
+
+/* Visible views get frame callbacks at the output refresh rate, the others
+ * are handed to the throttle timer.
+ */
+static void update_frame_throttling(struct woodland_output *output) {
+	uint32_t bit = 1u << output->index;
+	struct woodland_view *view;
+	wl_list_for_each(view, &output->server->views, link) {
+		if (!view->mapped || !(view->outputs & bit)) {
+			continue;
+		}
+		if (view->visible_outputs & bit) {
+			view->frames_done++;
+		}
+		else if (!view->visible_outputs && !view->throttled) {
+			frame_throttle_arm(output->server);
+		}
+		view->throttled = !view->visible_outputs;
+	}
+}
+
+/***************************** CPU compositing ********************************/
+/* Without a GPU wlroots falls back to the pixman renderer and a frame is a
+ * chain of pixman_image_composite32 calls on the compositor thread. The
+ * background, usually most of the damage, is split into tiles of CPU_TILE_SIZE
+ * pixels instead, and the tile pool draws them in parallel: every tile
+ * composites the ops clipped to itself, so threads never write the same pixel.
+ * Threads wrap the shared pixels in their own pixman images, pixman images
+ * aren't safe to share between threads.
+ * Only pixels the compositor owns go to the pool. A client can shrink its
+ * wl_shm pool under a buffer at any time, and the SIGBUS that follows is only
+ * caught on a thread inside wl_shm_buffer_begin_access, which the pixman
+ * renderer does around every draw of a surface on the compositor thread. The
+ * wl_shm_buffer behind a texture isn't reachable from here, so the surfaces
+ * are drawn by the renderer once the tiles are joined. Rotated or flipped
+ * outputs, which are rare, go through the renderer entirely.
+ */
+/* Source image of 'texture' mapped onto 'box', false if pixman can't draw it */
+static bool cpu_op_from_texture(struct cpu_op *op, struct wlr_texture *texture,
+						const struct wlr_fbox *src_box, const struct wlr_box *box,
+												pixman_region32_t *region) {
+	if (!wlr_texture_is_pixman(texture) || box->width <= 0 || box->height <= 0) {
+		return false;
+	}
+	pixman_image_t *image = wlr_pixman_texture_get_image(texture);
+	if (!image) {
+		return false;
+	}
+	op->region = region;
+	op->pixels = pixman_image_get_data(image);
+	op->format = pixman_image_get_format(image);
+	op->width = pixman_image_get_width(image);
+	op->height = pixman_image_get_height(image);
+	op->stride = pixman_image_get_stride(image);
+	double scale_x = src_box->width / box->width;
+	double scale_y = src_box->height / box->height;
+	struct pixman_f_transform transform = {
+		.m = {
+			{ scale_x, 0.0, src_box->x - box->x * scale_x },
+			{ 0.0, scale_y, src_box->y - box->y * scale_y },
+			{ 0.0, 0.0, 1.0 },
+		},
+	};
+	pixman_transform_from_pixman_f_transform(&op->transform, &transform);
+	op->filter = scale_x == 1.0 && scale_y == 1.0 ? PIXMAN_FILTER_NEAREST : PIXMAN_FILTER_BILINEAR;
+	return true;
+}
+
+/* Runs on any thread of the pool */
+static void cpu_render_tile(size_t index, void *data) {
+	const struct cpu_frame *frame = data;
+	const pixman_box32_t *tile = &frame->tiles[index];
+	pixman_image_t *target = pixman_image_create_bits_no_clear(frame->format, frame->width,
+										frame->height, frame->pixels, frame->stride);
+	if (!target) {
+		return;
+	}
+	pixman_region32_t region;
+	pixman_region32_init(&region);
+	for (size_t i = 0; i < frame->num_ops; i++) {
+		const struct cpu_op *op = &frame->ops[i];
+		pixman_region32_intersect_rect(&region, op->region, tile->x1, tile->y1,
+										tile->x2 - tile->x1, tile->y2 - tile->y1);
+		if (!pixman_region32_not_empty(&region)) {
+			continue;
+		}
+		pixman_image_t *source;
+		if (op->pixels) {
+			source = pixman_image_create_bits_no_clear(op->format, op->width, op->height,
+														op->pixels, op->stride);
+			if (source) {
+				pixman_image_set_transform(source, &op->transform);
+				pixman_image_set_filter(source, op->filter, NULL, 0);
+			}
+		}
+		else {
+			source = pixman_image_create_solid_fill(&op->color);
+		}
+		if (!source) {
+			continue;
+		}
+		int num_rects;
+		pixman_box32_t *rects = pixman_region32_rectangles(&region, &num_rects);
+		for (int r = 0; r < num_rects; r++) {
+			pixman_image_composite32(op->op, source, NULL, target, rects[r].x1, rects[r].y1,
+										0, 0, rects[r].x1, rects[r].y1,
+										rects[r].x2 - rects[r].x1, rects[r].y2 - rects[r].y1);
+		}
+		pixman_image_unref(source);
+	}
+	pixman_region32_fini(&region);
+	pixman_image_unref(target);
+}
+
+/* Damaged tiles, aligned on a grid so a surface moving around keeps the same
+ * tile boundaries.
+ */
+static size_t cpu_collect_tiles(struct woodland_output *output, pixman_region32_t *damage) {
+	pixman_box32_t *extents = pixman_region32_extents(damage);
+	int x0 = extents->x1 - ((extents->x1 % CPU_TILE_SIZE) + CPU_TILE_SIZE) % CPU_TILE_SIZE;
+	int y0 = extents->y1 - ((extents->y1 % CPU_TILE_SIZE) + CPU_TILE_SIZE) % CPU_TILE_SIZE;
+	size_t num_tiles = 0;
+	for (int y = y0; y < extents->y2; y += CPU_TILE_SIZE) {
+		for (int x = x0; x < extents->x2; x += CPU_TILE_SIZE) {
+			pixman_box32_t tile = {
+				.x1 = x > extents->x1 ? x : extents->x1,
+				.y1 = y > extents->y1 ? y : extents->y1,
+				.x2 = x + CPU_TILE_SIZE < extents->x2 ? x + CPU_TILE_SIZE : extents->x2,
+				.y2 = y + CPU_TILE_SIZE < extents->y2 ? y + CPU_TILE_SIZE : extents->y2,
+			};
+			if (pixman_region32_contains_rectangle(damage, &tile) == PIXMAN_REGION_OUT) {
+				continue;
+			}
+			if (num_tiles == output->cap_cpu_tiles) {
+				size_t cap = output->cap_cpu_tiles ? output->cap_cpu_tiles * 2 : 64;
+				pixman_box32_t *tiles = realloc(output->cpu_tiles, cap * sizeof(pixman_box32_t));
+				if (!tiles) {
+					wlr_log(WLR_ERROR, "Error: Failed to allocate memory in 'cpu_collect_tiles'!");
+					return 0;
+				}
+				output->cpu_tiles = tiles;
+				output->cap_cpu_tiles = cap;
+			}
+			output->cpu_tiles[num_tiles++] = tile;
+		}
+	}
+	return num_tiles;
+}
+
+/* Composites the background on the tile pool where it shows, 'background',
+ * false if it has to go through the renderer instead.
+ */
+static bool render_scene_cpu(struct woodland_output *output, struct render_data *rdata,
+													pixman_region32_t *background) {
+	struct woodland_server *server = output->server;
+	if (!server->tilepool || !wlr_renderer_is_pixman(rdata->renderer) ||
+		rdata->output->transform != WL_OUTPUT_TRANSFORM_NORMAL) {
+		return false;
+	}
+	pixman_image_t *image = wlr_pixman_renderer_get_current_image(rdata->renderer);
+	if (!image) {
+		return false;
+	}
+	// The background replaces what was there, its texture is the compositor's copy
+	struct cpu_op op;
+	int width, height;
+	wlr_output_transformed_resolution(rdata->output, &width, &height);
+	if (!output->background_texture ||
+		!cpu_op_from_texture(&op, output->background_texture, &(struct wlr_fbox){
+									.width = output->background_texture->width,
+									.height = output->background_texture->height},
+									&(struct wlr_box){.width = width, .height = height},
+									background)) {
+		op = (struct cpu_op){
+			.region = background,
+			.color = {0x1999, 0x1999, 0x1999, 0xffff},
+		};
+	}
+	op.op = PIXMAN_OP_SRC;
+	struct cpu_frame frame = {
+		.format = pixman_image_get_format(image),
+		.pixels = pixman_image_get_data(image),
+		.width = pixman_image_get_width(image),
+		.height = pixman_image_get_height(image),
+		.stride = pixman_image_get_stride(image),
+		.ops = &op,
+		.num_ops = 1,
+	};
+	size_t num_tiles = cpu_collect_tiles(output, background);
+	if (num_tiles == 0 && pixman_region32_not_empty(background)) {
+		return false;
+	}
+	frame.tiles = output->cpu_tiles;
+	// Joined here, nothing touches the buffer once the frame is committed
+	tilepool_run(server->tilepool, num_tiles, cpu_render_tile, &frame);
+	output->frames_cpu_tiled++;
+	return true;
+}
+
+/* Draws the output's render list, culled against 'rdata->damage': the
+ * background where no opaque surface covers it, then the visible surfaces
+ * bottom to top. Frame callbacks go to the surfaces that are on screen.
+ */
+static void render_scene(struct woodland_output *output, struct render_data *rdata) {
+	struct wlr_renderer *renderer = rdata->renderer;
+	struct wlr_output *wlr_output = output->wlr_output;
+	// Find out what is visible, the cost of the frame depends on it and not on the number of views
+	if (output->render_list_dirty) {
+		render_list_build(output);
+	}
+	pixman_region32_t covered;
+	pixman_region32_init(&covered);
+	render_list_cull(output, rdata, &covered);
+
+	// Render the background image if available, only where damaged and not covered
+	pixman_region32_t background;
+	pixman_region32_init(&background);
+	pixman_region32_subtract(&background, rdata->damage, &covered);
+	// Without a GPU the background may be composited on the tile pool
+	int num_rects = 0;
+	pixman_box32_t *rects = NULL;
+	if (!render_scene_cpu(output, rdata, &background)) {
+		rects = pixman_region32_rectangles(&background, &num_rects);
+	}
+	for (int i = 0; i < num_rects; i++) {
+		scissor_output(renderer, wlr_output, &rects[i]);
+		if (output->background_texture) {
+			wlr_render_texture_with_matrix(renderer,
+										   output->background_texture,
+										   output->background_matrix,
+										   1.0f);
+		}
+		else {
+			// Clear with default color if background texture is not available
+			float color[4] = {0.1, 0.1, 0.1, 1.0};
+			wlr_renderer_clear(renderer, color);
+		}
+	}
+	pixman_region32_fini(&background);
+	pixman_region32_fini(&covered);
+
+	// Render the visible surfaces bottom to top
+	for (size_t i = 0; i < output->num_render_items; i++) {
+		struct render_item *item = &output->render_items[i];
+		if (!item->occluded) {
+			render_texture(rdata, item->texture, &item->src_box, &item->visible,
+															item->matrix, item->alpha);
+		}
+		pixman_region32_fini(&item->visible);
+		/* This lets the client know that we've displayed that frame and it can
+		 * prepare another one now if it likes. Views that are entirely hidden
+		 * or off screen wait for the throttle timer. */
+		if (!item->view || (item->view->visible_outputs & (1u << output->index))) {
+			wlr_surface_send_frame_done(item->surface, rdata->when);
+		}
+	}
+	update_frame_throttling(output);
+	wlr_renderer_scissor(renderer, NULL);
+}
+
+/********************************** Magnifier *********************************/
+/* Zooming renders the part of the scene that ends up on screen once, at native
+ * resolution, into an offscreen buffer of the output's size, then samples that
+ * rectangle up to the whole output. The cost doesn't depend on the zoom level
+ * and only the wlroots renderer API is used, so it works with any renderer.
+ */
+static void magnifier_destroy(struct woodland_output *output) {
+	if (output->zoom_texture) {
+		wlr_texture_destroy(output->zoom_texture);
+		output->zoom_texture = NULL;
+	}
+	if (output->zoom_buffer) {
+		wlr_buffer_drop(output->zoom_buffer);
+		output->zoom_buffer = NULL;
+	}
+}
+
+/* Created on the first zoomed frame, recreated when the output mode changes */
+static bool magnifier_ensure_buffer(struct woodland_output *output) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	if (output->zoom_buffer && output->zoom_buffer->width == wlr_output->width &&
+								output->zoom_buffer->height == wlr_output->height) {
+		return true;
+	}
+	magnifier_destroy(output);
+	struct wlr_drm_format_set formats = {0};
+	wlr_drm_format_set_add(&formats, DRM_FORMAT_XRGB8888, DRM_FORMAT_MOD_INVALID);
+	const struct wlr_drm_format *format = wlr_drm_format_set_get(&formats, DRM_FORMAT_XRGB8888);
+	output->zoom_buffer = wlr_allocator_create_buffer(output->server->allocator,
+										wlr_output->width, wlr_output->height, format);
+	wlr_drm_format_set_finish(&formats);
+	if (!output->zoom_buffer) {
+		wlr_log(WLR_ERROR, "Error: Failed to allocate the zoom buffer in 'magnifier_ensure_buffer'!");
+		return false;
+	}
+	output->zoom_texture = wlr_texture_from_buffer(output->server->renderer, output->zoom_buffer);
+	if (!output->zoom_texture) {
+		wlr_log(WLR_ERROR, "Error: Failed to create the zoom texture in 'magnifier_ensure_buffer'!");
+		magnifier_destroy(output);
+		return false;
+	}
+	return true;
+}
 
-	/* This lets the client know that we've displayed that frame and it can
-	 * prepare another one now if it likes. */
-	wlr_surface_send_frame_done(surface, rdata->when);
+/* The rectangle of the scene shown while zoomed, in output-local coordinates.
+ * A point p ends up at p * zoom_factor - pan_offset, like the cursor mapping.
+ */
+static struct wlr_box magnifier_source_box(struct woodland_output *output) {
+	struct woodland_server *server = output->server;
+	int width, height;
+	wlr_output_transformed_resolution(output->wlr_output, &width, &height);
+	struct wlr_box box = {
+		.x = server->pan_offset_x / server->zoom_factor,
+		.y = server->pan_offset_y / server->zoom_factor,
+		.width = ceil(width / server->zoom_factor),
+		.height = ceil(height / server->zoom_factor),
+	};
+	return box;
 }
 
-static void render_layer_surface(struct wlr_surface *surface, int sx, int sy, void *data) {
-	(void)sx;
-	(void)sy;
-	if (!surface || !surface->buffer || !surface->buffer->texture) {
-		wlr_log(WLR_ERROR, "Error: Invalid surface in 'render_layer_surface'!");
-		return;
-	}
-	struct render_data *rdata = data;
-	if ((!rdata) || (rdata == NULL)) {
+/* Magnification filter, wlroots has no API for it. The GLES2 renderer samples
+ * with GL_LINEAR unless told otherwise, pixman always filters bilinearly.
+ */
+static void magnifier_set_filter(struct woodland_output *output) {
+	if (!wlr_texture_is_gles2(output->zoom_texture)) {
 		return;
 	}
-	struct wlr_output *output = rdata->output;
-	if ((!output) || (output == NULL)) {
-		return;
+	struct wlr_gles2_texture_attribs attribs;
+	wlr_gles2_texture_get_attribs(output->zoom_texture, &attribs);
+	glBindTexture(attribs.target, attribs.tex);
+	glTexParameteri(attribs.target, GL_TEXTURE_MAG_FILTER,
+					output->server->zoom_filter_nearest ? GL_NEAREST : GL_LINEAR);
+	glBindTexture(attribs.target, 0);
+}
+
+/* Composites the cursors the backend didn't put on a hardware plane, the
+ * fallback for outputs without one or images the plane can't take.
+ */
+static void output_render_cursors(struct woodland_output *output, pixman_region32_t *damage) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &wlr_output->cursors, link) {
+		if (cursor->enabled && cursor->visible && wlr_output->hardware_cursor != cursor) {
+			wlr_output_render_software_cursors(wlr_output, damage);
+			output->frames_software_cursor++;
+			return;
+		}
 	}
-	struct wlr_renderer *renderer = surface->renderer;
-	if ((!renderer) || (renderer == NULL)) {
-		return;
+	if (wlr_output->hardware_cursor) {
+		output->frames_hardware_cursor++;
 	}
-	struct wlr_texture *texture = surface->buffer->texture;
-	if ((!texture) || (texture == NULL)) {
-		return;
+}
+
+/* Renders a zoomed frame, the output buffer must not be attached yet since the
+ * offscreen pass binds its own buffer.
+ */
+static bool magnifier_render(struct woodland_output *output, struct timespec *now) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_renderer *renderer = output->server->renderer;
+	if (!magnifier_ensure_buffer(output)) {
+		return false;
 	}
-	struct woodland_view *view = rdata->view;
-	if ((!view) || (view == NULL)) {
-		return;
+	// First pass: the visible part of the scene at native resolution
+	struct wlr_box source = magnifier_source_box(output);
+	pixman_region32_t damage;
+	pixman_region32_init_rect(&damage, source.x, source.y, source.width, source.height);
+	struct render_data rdata = {
+		.output = wlr_output,
+		.renderer = renderer,
+		.when = now,
+		.damage = &damage,
+	};
+	if (!wlr_renderer_begin_with_buffer(renderer, output->zoom_buffer)) {
+		wlr_log(WLR_ERROR, "Error: Failed to render to the zoom buffer in 'magnifier_render'!");
+		pixman_region32_fini(&damage);
+		return false;
 	}
+	render_scene(output, &rdata);
+	wlr_renderer_end(renderer);
+	pixman_region32_fini(&damage);
 
-	struct wlr_box box;
-	box.x = sx + rdata->lview->x;
-	box.y = sy + rdata->lview->y;
-	box.width = surface->current.width;
-	box.height = surface->current.height;
-
-	wlr_matrix_project_box(view->server->matrix,
-						   &box,
-						   WL_OUTPUT_TRANSFORM_NORMAL,
-						   0.0,
-						   output->transform_matrix);
-	wlr_render_texture_with_matrix(renderer, texture, view->server->matrix, 1);
-	wlr_surface_send_frame_done(surface, rdata->when);
+	// Second pass: sample the source rectangle up to the whole output
+	if (!wlr_output_attach_render(wlr_output, NULL)) {
+		wlr_log(WLR_ERROR, "Error: Failed to attach renderer in 'magnifier_render'!");
+		return false;
+	}
+	int width, height;
+	wlr_output_transformed_resolution(wlr_output, &width, &height);
+	// Both buffers are in buffer coordinates, only the source box has to be transformed
+	enum wl_output_transform transform = wlr_output_transform_invert(wlr_output->transform);
+	wlr_box_transform(&source, &source, transform, width, height);
+	struct wlr_fbox src_box = {
+		.x = source.x,
+		.y = source.y,
+		.width = source.width,
+		.height = source.height,
+	};
+	float identity[9];
+	wlr_matrix_identity(identity);
+	float matrix[9];
+	wlr_matrix_project_box(matrix, &(struct wlr_box){
+							.width = wlr_output->width,
+							.height = wlr_output->height},
+							WL_OUTPUT_TRANSFORM_NORMAL, 0.0, identity);
+	wlr_renderer_begin(renderer, wlr_output->width, wlr_output->height);
+	magnifier_set_filter(output);
+	wlr_render_subtexture_with_matrix(renderer, output->zoom_texture, &src_box, matrix, 1.0f);
+	output_render_cursors(output, NULL);
+	wlr_renderer_end(renderer);
+	// The whole output changes with every zoomed frame
+	pixman_region32_t frame_damage;
+	pixman_region32_init_rect(&frame_damage, 0, 0, wlr_output->width, wlr_output->height);
+	wlr_output_set_damage(wlr_output, &frame_damage);
+	pixman_region32_fini(&frame_damage);
+	return true;
 }
 
-static void output_frame(struct wl_listener *listener, void *data) {
+static void output_render_frame(struct wl_listener *listener, void *data) {
 	(void)data;
 	// Get the current time
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
 	// Retrieve the woodland_output structure from the listener
 	struct woodland_output *output = wl_container_of(listener, output, frame);
+	struct wlr_output *wlr_output = output->wlr_output;
+	output->frame_pending = false;
 	// This stopps the rendering completely after setting the screen black
-	if (output->server->render_full_stop) {
+	if (output->blanked) {
+		output->frames_skipped++;
 		return;
 	}
 	// Define the renderer
 	struct wlr_renderer *renderer = output->server->renderer;
-	// Attach the renderer to the output
-	if (!wlr_output_attach_render(output->wlr_output, NULL)) {
-		wlr_log(WLR_ERROR, "Error: Failed to attach renderer in 'output_frame'!");
+	// Attach the renderer to the output, 'damage' is what changed since this buffer was shown
+	bool needs_frame;
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	if (!wlr_output_damage_attach_render(output->damage, &needs_frame, &damage)) {
+		wlr_log(WLR_ERROR, "Error: Failed to attach renderer in 'output_render_frame'!");
+		pixman_region32_fini(&damage);
+		return;
+	}
+	// Nothing changed, skip the frame
+	if (!needs_frame) {
+		output->frames_skipped++;
+		wlr_output_rollback(wlr_output);
+		send_frame_done(output->server, &now);
+		pixman_region32_fini(&damage);
 		return;
 	}
-	// Begin rendering
-	wlr_renderer_begin(renderer, output->wlr_output->width, output->wlr_output->height);
 	// Stop rendering on idle and clear to black
 	if (!output->server->should_render) {
+		wlr_renderer_begin(renderer, wlr_output->width, wlr_output->height);
 		float color[4] = {0.0, 0.0, 0.0, 1.0}; // Set alpha to 1.0 for opaque black
 		wlr_renderer_clear(renderer, color);
 		wlr_renderer_end(renderer);
-		wlr_output_commit(output->wlr_output);
-		output->server->render_full_stop = true;
+		wlr_output_commit(wlr_output);
+		output->blanked = true;
+		output->frames_rendered++;
+		pixman_region32_fini(&damage);
 		return;
 	}
 
-	// Zooming the output
+	// Zooming the output, the magnifier attaches the output buffer itself
 	if (output->server->zoom_factor > 1.0) {
-		// Set the new viewport with scaling and panning
-		glViewport(
-			(GLint)(-output->server->pan_offset_x),
-			(GLint)(-output->server->pan_offset_y),
-			(GLsizei)(output->wlr_output->width * output->server->zoom_factor),
-			(GLsizei)(output->wlr_output->height * output->server->zoom_factor)
-		);
+		pixman_region32_fini(&damage);
+		wlr_output_rollback(wlr_output);
+		if (!magnifier_render(output, &now)) {
+			wlr_output_rollback(wlr_output);
+			return;
+		}
+		if (!wlr_output_commit(wlr_output)) {
+			wlr_log(WLR_ERROR, "Failed to commit output");
+		}
+		output->frames_rendered++;
+		return;
 	}
 
 	// Prepare render_data structure
 	struct render_data rdata = {
-		.output = output->wlr_output,
+		.output = wlr_output,
 		.renderer = renderer,
-		.when = &now
+		.when = &now,
+		.damage = &damage,
 	};
+	// Begin rendering
+	wlr_renderer_begin(renderer, wlr_output->width, wlr_output->height);
+	render_scene(output, &rdata);
+	// Render software cursors
+	output_render_cursors(output, &damage);
+	// End rendering
+	wlr_renderer_end(renderer);
 
-	// Render the background image if available
-	if (output->server->background_texture) {
-		wlr_render_texture_with_matrix(renderer,
-									   output->server->background_texture,
-									   output->server->background_matrix,
-									   1.0f);
+	// Tell the backend which part of the buffer changed, in buffer coordinates
+	int width, height;
+	wlr_output_transformed_resolution(wlr_output, &width, &height);
+	pixman_region32_t frame_damage;
+	pixman_region32_init(&frame_damage);
+	enum wl_output_transform transform = wlr_output_transform_invert(wlr_output->transform);
+	wlr_region_transform(&frame_damage, &output->damage->current, transform, width, height);
+	wlr_output_set_damage(wlr_output, &frame_damage);
+	pixman_region32_fini(&frame_damage);
+	pixman_region32_fini(&damage);
+	// Commit the rendered output
+	if (!wlr_output_commit(wlr_output)) {
+		wlr_log(WLR_ERROR, "Failed to commit output");
 	}
-	else {
-		// Clear with default color if background texture is not available
-		float color[4] = {0.1, 0.1, 0.1, 1.0};
-		wlr_renderer_clear(renderer, color);
+	output->frames_rendered++;
+}
+
+/* Only frames that were rendered are timed, skipped ones cost next to nothing */
+static void output_frame(struct wl_listener *listener, void *data) {
+	if (!listener) {
+		wlr_log(WLR_ERROR, "'listener' is NULL in 'output_frame'");
+		return;
+	}
+	struct woodland_output *output = wl_container_of(listener, output, frame);
+	// Pointer focus and pan are brought up to date before the frame shows them
+	cursor_motion_flush(output->server);
+	unsigned long frames_rendered = output->frames_rendered;
+	uint64_t start = timing_now_ns();
+	output_render_frame(listener, data);
+	if (output->frames_rendered != frames_rendered) {
+		histogram_add(&output->frame_time, timing_now_ns() - start);
 	}
+}
 
-	// Render each view in reverse order
-	struct woodland_view *view;
-	wl_list_for_each_reverse(view, &output->server->views, link) {
-		if (view->mapped) {
-			rdata.view = view;
-			wlr_xdg_surface_for_each_surface(view->xdg_surface, render_surface, &rdata);
-		}
+/* Runs on the event loop once the worker thread scaled the background for an
+ * output, the pixels are freed by the loader right after the upload.
+ */
+static void background_image_ready(const char *path, const struct bgloader_image *image,
+																		void *data) {
+	struct background_request *request = data;
+	struct woodland_output *output = request->output;
+	free(request);
+	if (!output) {
+		return; // the output is gone or asked for another size meanwhile
+	}
+	output->background_request = NULL;
+	if (!image) {
+		return;
+	}
+	struct wlr_texture *texture = wlr_texture_from_pixels(output->server->renderer,
+														  output->server->background_format,
+														  image->stride,
+														  image->width,
+														  image->height,
+														  image->pixels);
+	if (!texture) {
+		wlr_log(WLR_ERROR, "Failed to create texture from image: %s", path);
+		return;
+	}
+	if (output->background_texture) {
+		wlr_texture_destroy(output->background_texture);
 	}
+	output->background_texture = texture;
+	wlr_output_damage_add_whole(output->damage);
+}
 
-	// Render each layer view in reverse order
-	struct woodland_layer_view *layer_view;
-	wl_list_for_each_reverse(layer_view, &output->server->layer_surfaces, link) {
-		if (layer_view->mapped) {
-			rdata.lview = layer_view;
-			wlr_layer_surface_v1_for_each_surface(layer_view->layer_surface,
-												  render_layer_surface,
-												  &rdata);
+/* The background is scaled once to the output's resolution, so frames draw it
+ * texel for texel. A new image is only requested when that resolution changes.
+ */
+static void output_update_background(struct woodland_output *output) {
+	struct woodland_server *server = output->server;
+	int width, height;
+	wlr_output_transformed_resolution(output->wlr_output, &width, &height);
+	wlr_matrix_project_box(output->background_matrix, &(struct wlr_box){
+							.width = width,
+							.height = height},
+							WL_OUTPUT_TRANSFORM_NORMAL,
+							0.0,
+							output->wlr_output->transform_matrix);
+	if (!server->background_path || width <= 0 || height <= 0 ||
+		(width == output->background_width && height == output->background_height)) {
+		return;
+	}
+	output->background_width = width;
+	output->background_height = height;
+	// A scaling still in flight is for the previous size
+	if (output->background_request) {
+		output->background_request->output = NULL;
+		output->background_request = NULL;
+	}
+	struct background_request *request = calloc(1, sizeof(struct background_request));
+	if (!request) {
+		wlr_log(WLR_ERROR, "Error: Failed to allocate memory in 'output_update_background'!");
+		return;
+	}
+	request->output = output;
+	enum imagescale_format format = server->background_format == DRM_FORMAT_ARGB8888 ?
+												IMAGESCALE_BGRA : IMAGESCALE_RGBA;
+	if (!bgloader_scale(server->bgloader, server->background_path, width, height,
+				server->background_mode, format, background_image_ready, request)) {
+		wlr_log(WLR_ERROR, "Error: Failed to queue the background in 'output_update_background'!");
+		free(request);
+		return;
+	}
+	output->background_request = request;
+}
+
+/* Whether the frame the output just rendered drew the surface */
+static bool output_shows_surface(struct wlr_surface *surface, void *data) {
+	struct woodland_output *output = data;
+	if (output->blanked) {
+		return false;
+	}
+	for (size_t i = 0; i < output->num_render_items; i++) {
+		struct render_item *item = &output->render_items[i];
+		if (item->surface == surface && !item->occluded) {
+			return true;
 		}
 	}
+	return false;
+}
 
-	// Render software cursors
-	wlr_output_render_software_cursors(output->wlr_output, NULL);
-	// End rendering
-	wlr_renderer_end(renderer);
-	// Commit the rendered output
-	if (!wlr_output_commit(output->wlr_output)) {
-		wlr_log(WLR_ERROR, "Failed to commit output");
+static void output_handle_commit(struct wl_listener *listener, void *data) {
+	struct wlr_output_event_commit *event = data;
+	struct woodland_output *output = wl_container_of(listener, output, commit);
+	if (event->committed & WLR_OUTPUT_STATE_SCALE) {
+		cursor_load_scale(output->server, output->wlr_output->scale);
 	}
+	if (event->committed & WLR_OUTPUT_STATE_BUFFER) {
+		latency_output_commit(output->server->latency, output->wlr_output,
+										output_shows_surface, output);
+	}
+}
+
+static void output_handle_present(struct wl_listener *listener, void *data) {
+	struct woodland_output *output = wl_container_of(listener, output, present);
+	latency_output_present(output->server->latency, data);
+}
+
+static void output_destroy(struct wl_listener *listener, void *data) {
+	(void)data;
+	struct woodland_output *output = wl_container_of(listener, output, destroy);
+	wlr_log(WLR_INFO, "Output %s: %lu frames rendered, %lu skipped, %lu surfaces culled, "
+							"%lu render list builds, %lu frames on the tile pool",
+							output->wlr_output->name, output->frames_rendered,
+							output->frames_skipped, output->surfaces_culled,
+							output->render_list_builds, output->frames_cpu_tiled);
+	wlr_log(WLR_INFO, "Output %s: %lu frames with a hardware cursor, %lu with a software cursor",
+							output->wlr_output->name, output->frames_hardware_cursor,
+							output->frames_software_cursor);
+	char timing[160];
+	histogram_format(&output->frame_time, timing, sizeof(timing));
+	wlr_log(WLR_INFO, "Timing output_frame on %s: %s", output->wlr_output->name, timing);
+	/* Views forget the output, wlroots already sent wl_surface leave so it
+	 * leaves the list first. A view it was the last output of is throttled. */
+	wl_list_remove(&output->link);
+	uint32_t bit = 1u << output->index;
+	struct woodland_view *view;
+	wl_list_for_each(view, &output->server->views, link) {
+		view_set_outputs(view, view->outputs & ~bit);
+	}
+	wl_list_for_each(view, &output->server->minimized_views, link) {
+		view_set_outputs(view, view->outputs & ~bit);
+	}
+	// The output damage is destroyed together with the output
+	wl_list_remove(&output->frame.link);
+	wl_list_remove(&output->destroy.link);
+	wl_list_remove(&output->commit.link);
+	wl_list_remove(&output->present.link);
+	latency_output_destroy(output->server->latency, output->wlr_output);
+	magnifier_destroy(output);
+	if (output->background_request) {
+		output->background_request->output = NULL;
+	}
+	if (output->background_texture) {
+		wlr_texture_destroy(output->background_texture);
+	}
+	hitgrid_destroy(output->hitgrid);
+	free(output->render_items);
+	free(output->cpu_tiles);
+	free(output);
+}
+
+/* Outputs were added, removed or moved: refresh their layout boxes and the
+ * outputs every view is on.
+ */
+static void output_layout_change(struct wl_listener *listener, void *data) {
+	(void)data;
+	struct woodland_server *server = wl_container_of(listener, server, output_layout_change);
+	struct woodland_output *output;
+	wl_list_for_each(output, &server->outputs, link) {
+		struct wlr_box *box = wlr_output_layout_get_box(server->output_layout, output->wlr_output);
+		output->layout_box = box ? *box : (struct wlr_box){0};
+		// The layout changes with the mode and the transform of an output too
+		output_update_background(output);
+	}
+	hit_grids_rebuild(server);
+	struct woodland_view *view;
+	wl_list_for_each(view, &server->views, link) {
+		view_update_outputs(view);
+	}
+	damage_whole(server);
 }
 
 static void handle_output_configuration_applied(struct wl_listener *listener, void *data) {
@@ -2233,27 +3507,53 @@ static void server_new_output(struct wl_listener *listener, void *data) {
 			return;
 		}
 	}
+	/* Each output gets the lowest free bit of the views' output masks */
+	uint32_t used = 0;
+	struct woodland_output *iter;
+	wl_list_for_each(iter, &server->outputs, link) {
+		used |= 1u << iter->index;
+	}
+	int index = 0;
+	while (index < MAX_OUTPUTS && (used & (1u << index))) {
+		index++;
+	}
+	if (index == MAX_OUTPUTS) {
+		wlr_log(WLR_ERROR, "Error: More than %d outputs in 'server_new_output'!", MAX_OUTPUTS);
+		return;
+	}
 	/* Allocates and configures our state for this output */
 	struct woodland_output *output = calloc(1, sizeof(struct woodland_output));
 	if (output == NULL) {
 		wlr_log(WLR_ERROR, "Error: Failed to allocate memory for woodland_output!");
 		return;
     }
+	output->index = index;
 	output->wlr_output = wlr_output;
+	output->render_list_dirty = true;
 	output->server = server;
 	output->server->should_render = true;
-	// Matrix for background image
-	wlr_matrix_project_box(output->server->background_matrix, &(struct wlr_box){
-							.x = -output->server->pan_offset_x,
-							.y = -output->server->pan_offset_y,
-							.width = output->wlr_output->width * output->server->zoom_factor,
-							.height = output->wlr_output->height * output->server->zoom_factor},
-							WL_OUTPUT_TRANSFORM_NORMAL,
-							0.0,
-							output->wlr_output->transform_matrix);
-	/* Sets up a listener for the frame notify event. */
+	output_update_background(output);
+	// Themed cursor images at the scale of this output
+	cursor_load_scale(server, wlr_output->scale);
+	// Filled once the output is in the layout, without it hit-testing walks every surface
+	output->hitgrid = hitgrid_create(&output->layout_box);
+	if (!output->hitgrid) {
+		wlr_log(WLR_ERROR, "Error: Failed to create the hit grid in 'server_new_output'!");
+	}
+	/* The destroy listener goes first so it runs before the output damage is
+	 * torn down by its own destroy listener. */
+	output->destroy.notify = output_destroy;
+	wl_signal_add(&wlr_output->events.destroy, &output->destroy);
+	output->damage = wlr_output_damage_create(wlr_output);
+	/* Sets up a listener for the frame notify event, the output damage emits it
+	 * only when something has to be repainted. */
 	output->frame.notify = output_frame;
-	wl_signal_add(&wlr_output->events.frame, &output->frame);
+	wl_signal_add(&output->damage->events.frame, &output->frame);
+	// Input latency follows the frames to the screen
+	output->commit.notify = output_handle_commit;
+	wl_signal_add(&wlr_output->events.commit, &output->commit);
+	output->present.notify = output_handle_present;
+	wl_signal_add(&wlr_output->events.present, &output->present);
 	wl_list_insert(&server->outputs, &output->link);
 	/* Adds this to the output layout. The add_auto function arranges outputs
 	 * from left-to-right in the order they appear. A more sophisticated
@@ -2265,6 +3565,8 @@ static void server_new_output(struct wl_listener *listener, void *data) {
 	 * output (such as DPI, scale factor, manufacturer, etc).
 	 */
 	wlr_output_layout_add_auto(server->output_layout, wlr_output);
+	// Clients started now will find a wl_output to show up on
+	autostart_output_ready(server->autostart);
 }
 
 /************************ XDG Shell and foreign toplevel implementation ***********************/
@@ -2285,6 +3587,8 @@ static void _xdg_surface_destroy(struct wl_listener *listener, void *data) {
 		wlr_log(WLR_ERROR, "Error: Empty 'server' in '_xdg_surface_destroy'!");
 		return;
 	}
+	// The hit grids must not keep pointing at it
+	hit_target_set_box(server, &view->hit, &(struct wlr_box){0});
 
 	struct wlr_seat *seat = server->seat;
 	if (!seat) {
@@ -2311,6 +3615,9 @@ static void _xdg_surface_destroy(struct wl_listener *listener, void *data) {
 			focus_surface = true;
 		}
 	}
+	wlr_log(WLR_INFO, "View %s: %lu frames at full rate, %lu throttled frame callbacks",
+				view->xdg_surface->toplevel->app_id ? view->xdg_surface->toplevel->app_id : "",
+				view->frames_done, view->frames_throttled);
 	// Clean up the foreign toplevel handle if it exists
 	if (view->xdg_surface->toplevel->requested.minimized && view->foreign_toplevel) {
 		wlr_foreign_toplevel_handle_v1_destroy(view->foreign_toplevel);
@@ -2410,12 +3717,16 @@ static void handle_foreign_toplevel_minimize(struct wl_listener *listener, void
 	if (view->foreign_toplevel) {
 		wlr_foreign_toplevel_handle_v1_set_minimized(view->foreign_toplevel, true);
 		// Remove the view from the list of active views
+		view_damage_whole(view);
 		if (!wl_list_empty(&view->link)) {
 			wl_list_remove(&view->link);
 			// Add it to the list of minimized views
 			wl_list_insert(&view->server->minimized_views, &view->link);
 		}
 		view->mapped = false;
+		view_set_outputs(view, 0);
+		view_update_hit_box(view);
+		frame_throttle_arm(view->server);
 	}
 	wlr_log(WLR_INFO, "Foreign handle minimized!");
 }
@@ -2428,6 +3739,7 @@ static void handle_foreign_activate_request(struct wl_listener *listener, void *
 		// Map the surface to show it
 		if (!view->mapped) {
 			view->mapped = true;
+			view_update_outputs(view);
 		}
 		if (view->xdg_surface->surface) {
 			if (view->foreign_toplevel) {
@@ -2445,90 +3757,75 @@ static void handle_foreign_activate_request(struct wl_listener *listener, void *
 }
 
 /* Get user defined window placement coordinates from wooldand.ini config */
-static void get_window_placement(char *file, char *ids[], char *identifiers[], int x[], int y[]) {
-	FILE *fp = fopen(file, "r");
-	if (fp == NULL) {
-		wlr_log(WLR_ERROR, "Could not open file %s", file);
-		return;
-	}
+static void get_window_placement(const struct config_store *conf, char *ids[],
+									char *identifiers[], int x[], int y[]) {
 	char line[1024];
 	int count = 0;
-	while (fgets(line, sizeof(line), fp) && count < 1024) {
-		// Ignore comments
-		if (line[0] == '#') {
-			continue;
+	const struct config_entry *entry = config_store_first(conf, "window_place");
+	for (; entry && count < 1024; entry = config_store_next(conf, entry)) {
+		// Work on a copy, the parser below splits the value in place
+		snprintf(line, sizeof(line), "%s\n", entry->value);
+		char *data = line;
+		while (isspace(*data)) {
+			data++;
 		}
-		// Look for lines that start with 'window_place'
-		if (strncmp(line, "window_place", 12) == 0) {
-			// Find the '=' sign
-			char *equal_sign = strchr(line, '=');
-			if (equal_sign == NULL) {
-				continue;
-			}
-			// Skip past '=' and any spaces
-			char *data = equal_sign + 1;
-			while (isspace(*data)) {
-				data++;
-			}
-			// Parse the id ('app_id:' or 'title:')
-			char *id_start = data;
-			while (*data && !isspace(*data)) {
-				data++;
-			}
-			*data = '\0';
-			ids[count] = strdup(id_start);
+		// Parse the id ('app_id:' or 'title:')
+		char *id_start = data;
+		while (*data && !isspace(*data)) {
 			data++;
-			// Skip spaces
-			while (isspace(*data)) {
-				data++;
-			}
-			// Parse the identifier (enclosed in double quotes if present)
-			char *identifier_start;
-			char *identifier_end;
-			if (*data == '"') {
-				identifier_start = data + 1;
-				identifier_end = strchr(identifier_start, '"');
-				if (identifier_end == NULL) {
-					free(ids[count]);
-					continue;
-				}
-			}
-			else {
-				identifier_start = data;
-				identifier_end = data;
-				while (*identifier_end && !isspace(*identifier_end)) {
-					identifier_end++;
-				}
-			}
-			*identifier_end = '\0';
-			identifiers[count] = strdup(identifier_start);
-			data = identifier_end + 1;
-			// Skip spaces
-			while (isspace(*data)) {
-				data++;
-			}
-			// Parse the x and y coordinates
-			char *x_str = data;
-			while (*data && !isspace(*data)) {
-				data++;
-			}
-			*data = '\0';
-			char *y_str = data + 1;
-			while (*data && !isspace(*data)) {
-				data++;
-			}
-			*data = '\0';
-			if (x_str == NULL || y_str == NULL) {
+		}
+		*data = '\0';
+		ids[count] = strdup(id_start);
+		data++;
+		// Skip spaces
+		while (isspace(*data)) {
+			data++;
+		}
+		// Parse the identifier (enclosed in double quotes if present)
+		char *identifier_start;
+		char *identifier_end;
+		if (*data == '"') {
+			identifier_start = data + 1;
+			identifier_end = strchr(identifier_start, '"');
+			if (identifier_end == NULL) {
 				free(ids[count]);
-				free(identifiers[count]);
 				continue;
 			}
-			x[count] = atoi(x_str);
-			y[count] = atoi(y_str);
-			count++;
 		}
+		else {
+			identifier_start = data;
+			identifier_end = data;
+			while (*identifier_end && !isspace(*identifier_end)) {
+				identifier_end++;
+			}
+		}
+		*identifier_end = '\0';
+		identifiers[count] = strdup(identifier_start);
+		data = identifier_end + 1;
+		// Skip spaces
+		while (isspace(*data)) {
+			data++;
+		}
+		// Parse the x and y coordinates
+		char *x_str = data;
+		while (*data && !isspace(*data)) {
+			data++;
+		}
+		*data = '\0';
+		char *y_str = data + 1;
+		while (*data && !isspace(*data)) {
+			data++;
+		}
+		*data = '\0';
+		if (x_str == NULL || y_str == NULL) {
+			free(ids[count]);
+			free(identifiers[count]);
+			continue;
+		}
+		x[count] = atoi(x_str);
+		y[count] = atoi(y_str);
+		count++;
 	}
-	fclose(fp);
 }
 
 static void xdg_surface_set_title(struct wl_listener *listener, void *data) {
@@ -2601,6 +3898,13 @@ static void xdg_surface_set_appid(struct wl_listener *listener, void *data) {
 	wlr_log(WLR_INFO, "XDG toplevel app_id set");
 }
 
+/* Lets the autostart scheduler know which client just showed its first surface */
+static void autostart_surface_mapped(struct woodland_server *server, struct wlr_surface *surface) {
+	pid_t pid = 0;
+	wl_client_get_credentials(wl_resource_get_client(surface->resource), &pid, NULL, NULL);
+	autostart_client_mapped(server->autostart, pid);
+}
+
 static void xdg_surface_map(struct wl_listener *listener, void *data) {
 	/* Called when the surface is mapped, or ready to display on-screen. */
 	(void)data;
@@ -2610,6 +3914,7 @@ static void xdg_surface_map(struct wl_listener *listener, void *data) {
 		wlr_log(WLR_ERROR, "Error: Empty 'view' in 'xdg_surface_map'!");
 		return;
 	}
+	autostart_surface_mapped(view->server, view->xdg_surface->surface);
 	struct wlr_output *output = wlr_output_layout_output_at(view->server->output_layout,
 																view->server->cursor->x,
 																view->server->cursor->y);
@@ -2628,9 +3933,10 @@ static void xdg_surface_map(struct wl_listener *listener, void *data) {
 	struct wlr_box geo_box;
 	wlr_xdg_surface_get_geometry(view->xdg_surface, &geo_box);
 
-	// Center the window
-	view->x = (output->width - geo_box.width) / 2;
-	view->y = (output->height - geo_box.height) / 2;
+	// Center the window on the output under the cursor
+	struct wlr_box *output_box = wlr_output_layout_get_box(view->server->output_layout, output);
+	view->x = (output_box ? output_box->x : 0) + (output->width - geo_box.width) / 2;
+	view->y = (output_box ? output_box->y : 0) + (output->height - geo_box.height) / 2;
 
 	// If the window width or height exceeds the screen geometry then resize to fit the screen
 	if (geo_box.width > output->width) {
@@ -2662,7 +3968,7 @@ static void xdg_surface_map(struct wl_listener *listener, void *data) {
 	// ids - is a char array containing the prefixes keywords (either keyword 'title:' or 'app_id:'
 	// identifiers - is a char array containing the actual window title or app_id
 	// x_arr and y_arr - char arrays containing x and y coordinates of windows to be placed
-	get_window_placement(view->server->config, ids, identifiers, x_arr, y_arr);
+	get_window_placement(view->server->conf, ids, identifiers, x_arr, y_arr);
 
 	// If 'surface->current.committed' == WLR_SURFACE_STATE_BUFFER it lets us know that
 	// the client required a toplevel move or resize and we can use this information
@@ -2797,6 +4103,8 @@ static void xdg_surface_map(struct wl_listener *listener, void *data) {
 	// Set mapped flag, this flag is read by rendering function
 	// and it renders only a view with mapped flag true
 	view->mapped = true;
+	view_update_outputs(view);
+	view_damage_whole(view);
 	
 	// Focus the view
 	focus_view(view, view->xdg_surface->surface);
@@ -2813,7 +4121,13 @@ static void xdg_surface_unmap(struct wl_listener *listener, void *data) {
 		wlr_log(WLR_ERROR, "Error: Empty 'view' in 'xdg_surface_unmap'!");
 		return;
 	}
+	view_damage_whole(view);
 	view->mapped = false;
+	view_set_outputs(view, 0);
+	view_update_hit_box(view);
+	// A resize in flight is abandoned, the next map places the view anew
+	view->resize_serial = 0;
+	view->resize_pending = false;
 	// Clean up the foreign toplevel handle if it exists
 	if (view->foreign_toplevel->state != WLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_MINIMIZED && \
 		(!view->xdg_surface->toplevel->requested.minimized && view->foreign_toplevel)) {
@@ -2851,6 +4165,9 @@ static void begin_interactive(struct woodland_view *view,
 	server->cursor_mode = mode;
 
 	if (mode == WOODLAND_CURSOR_MOVE) {
+		// The view stays where it is dragged, even if a resize is still acked later
+		view->resize_serial = 0;
+		view->resize_pending = false;
 		server->grab_x = ((server->cursor->x + server->pan_offset_x) / \
 											server->zoom_factor) - view->x;
 		server->grab_y = ((server->cursor->y + server->pan_offset_y) / \
@@ -2896,9 +4213,12 @@ static void xdg_toplevel_request_fullscreen(struct wl_listener *listener, void *
 			return;
 		}
 
-		// Set the view position to (0, 0)
-		view->x = 0;
-		view->y = 0;
+		// Set the view position to the top left corner of the output
+		struct wlr_box *output_box = wlr_output_layout_get_box(view->server->output_layout, output);
+		view_damage_whole(view);
+		view->x = output_box ? output_box->x : 0;
+		view->y = output_box ? output_box->y : 0;
+		view_update_outputs(view);
 
 		// Get the output's resolution and set the surface size
 		int width;
@@ -2911,7 +4231,6 @@ static void xdg_toplevel_request_fullscreen(struct wl_listener *listener, void *
 		if (view->foreign_toplevel) {
 			wlr_foreign_toplevel_handle_v1_set_fullscreen(view->foreign_toplevel, true);
 		}
-		wlr_output_commit(output);
 	}
 	else {
 		// Restore the original size and position
@@ -2919,8 +4238,10 @@ static void xdg_toplevel_request_fullscreen(struct wl_listener *listener, void *
 		view->is_fullscreen = false;
 
 		// Restore the original size and position
+		view_damage_whole(view);
 		view->x = view->original_x;
 		view->y = view->original_y;
+		view_update_outputs(view);
 		/* As much as i tried to avoid using magic numbers
 		 * i couldn't figure out why the window width was larger
 		 * on exiting the fullscreen mode, hence 'original_width - 30'
@@ -2981,14 +4302,6 @@ static void xdg_toplevel_request_minimize(struct wl_listener *listener, void *da
 		return;
 	}
 	struct woodland_server *server = view->server;
-	struct wlr_output *output;
-	struct wlr_surface_output *surface_output;
-	wl_list_for_each(surface_output, &view->xdg_surface->surface->current_outputs, link) {
-		output = surface_output->output;
-		if (output) {
-			break;
-		}
-	}
 	// Remove the view from the list of active views
 	if (!wl_list_empty(&view->link)) {
 		wl_list_remove(&view->link);
@@ -2996,15 +4309,16 @@ static void xdg_toplevel_request_minimize(struct wl_listener *listener, void *da
 		wl_list_insert(&server->minimized_views, &view->link);
 	}
 	// Unmap the surface to hide it
+	// The unmap handler sends wl_surface leave for every output the view was on
 	if (view->xdg_surface->mapped) {
-		wlr_surface_send_leave(view->xdg_surface->surface, output);
 		wl_signal_emit(&view->xdg_surface->events.unmap, &view->unmap);
 		wlr_xdg_surface_schedule_configure(view->xdg_surface);
 		if (view->foreign_toplevel) {
 			wlr_foreign_toplevel_handle_v1_set_minimized(view->foreign_toplevel, true);
 		}
 	}
-	// Optionally, you might want to call a render function to update the display
+	// Minimized views only get a frame callback every FRAME_THROTTLE_INTERVAL_MS
+	frame_throttle_arm(server);
 }
 
 static void server_new_xdg_surface(struct wl_listener *listener, void *data) {
@@ -3089,6 +4403,8 @@ static void server_new_xdg_surface(struct wl_listener *listener, void *data) {
 	wl_signal_add(&toplevel->events.request_fullscreen, &view->request_fullscreen);
 
 	/* Add it to the list of views. */
+	view->hit.view = view;
+	view->hit.stack = ++server->hit_stack;
 	wl_list_insert(&server->views, &view->link);
 	wlr_log(WLR_INFO, "XDG new surface created!");
 }
@@ -3152,6 +4468,7 @@ static void arrange_layers(struct woodland_layer_view *layer_view,
 	// Assgning x and y coordinates for the surface
 	layer_view->x = x;
 	layer_view->y = y;
+	layer_view_update_hit_box(layer_view);
 	// This fixes slurp
 	if ((state->desired_width == 0) || (state->desired_height == 0)) {
 		state->desired_width = output_width;
@@ -3180,6 +4497,8 @@ static void layer_surface_destroy(struct wl_listener *listener, void *data) {
     if (!wl_list_empty(&layer_view->destroy.link)) {
         wl_list_remove(&layer_view->destroy.link);
     }
+    // The hit grids must not keep pointing at it
+    hit_target_set_box(layer_view->server, &layer_view->hit, &(struct wlr_box){0});
     if (!wl_list_empty(&layer_view->link)) {
     	wl_list_remove(&layer_view->link);
     }
@@ -3199,6 +4518,8 @@ static void wlr_surface_commit(struct wl_listener *listener, void *data) {
 		return;
 	}
     if (layer_view->layer_surface->current.committed) {
+    	// Panels are small and rarely rearranged, repaint everything
+    	damage_whole(layer_view->server);
     	arrange_layers(layer_view, layer_view->layer_surface, layer_view->layer_surface->output,
 															&layer_view->layer_surface->current);
 	    wlr_log(WLR_INFO, "Layer surface committed: %p", layer_view->layer_surface);
@@ -3213,6 +4534,9 @@ static void layer_surface_map(struct wl_listener *listener, void *data) {
 		return;
 	}
     layer_view->mapped = true;
+    layer_view_update_hit_box(layer_view);
+    damage_whole(layer_view->server);
+    autostart_surface_mapped(layer_view->server, layer_view->layer_surface->surface);
     wlr_log(WLR_INFO, "Layer surface mapped: %p", layer_view->layer_surface);
 }
 
@@ -3225,6 +4549,8 @@ static void layer_surface_unmap(struct wl_listener *listener, void *data) {
 		return;
 	}
     layer_view->mapped = false;
+    layer_view_update_hit_box(layer_view);
+    damage_whole(layer_view->server);
     wlr_log(WLR_INFO, "Layer surface unmapped: %p", data);
 }
 
@@ -3251,6 +4577,8 @@ static void server_new_layer_surface(struct wl_listener *listener, void *data) {
 	layer_view->mapped = false;
 	layer_view->server = server;
 	layer_view->layer_surface = layer_surface;
+	layer_view->hit.layer_view = layer_view;
+	layer_view->hit.stack = ++server->hit_stack;
     if (!layer_surface->output) {
 		struct wlr_output *output = wlr_output_layout_output_at(layer_view->server->output_layout,
 																layer_view->server->cursor->x,
@@ -3285,42 +4613,9 @@ static void server_new_layer_surface(struct wl_listener *listener, void *data) {
 	wlr_log(WLR_INFO, "Layer surface configured: %p", layer_surface);
 }
 
-/* Set background image function */
-static int set_background_image_func(void *data) {
-	struct woodland_server *server = data;
-	if (!server) {
-		wlr_log(WLR_ERROR, "Failed to get woodland_server!");
-		return 1;
-	}
-	int width;
-	int height;
-	int channels;
-	char *background_img = get_char_value_from_conf(server->config, "background");
-	unsigned char *pixels = stbi_load(background_img, &width, &height, &channels, STBI_rgb_alpha);
-	if (!pixels) {
-		wlr_log(WLR_ERROR, "No background image provided or Failed to load: %s", background_img);
-		return 1;
-	}
-	server->background_texture = wlr_texture_from_pixels(server->renderer,
-														DRM_FORMAT_ABGR8888,
-														width * 4,
-														width,
-														height,
-														pixels);
-	stbi_image_free(pixels);
-	free(background_img);
-	background_img = NULL;
-	if (!server->background_texture) {
-		wlr_log(WLR_ERROR, "Failed to create texture from image: %s", background_img);
-		return 1;
-	}
-	wl_event_source_remove(server->timer);
-	return 0;
-}
-
 /* Run a terminal at startup of no startup command specified */
 // Function to find and open the first available terminal emulator
-static void startup_terminal(void) {
+static void startup_terminal(struct woodland_server *server) {
 	char *terminals[] = {"foot", "xfce4-terminal", "kitty", "gnome-terminal", "alacritty"};
 	char *bin_paths[] = {"/usr/bin/", "/usr/local/bin/"};
 	int num_terminals = sizeof(terminals) / sizeof(terminals[0]);
@@ -3332,9 +4627,9 @@ static void startup_terminal(void) {
 			snprintf(terminal_path, sizeof(terminal_path), "%s%s", bin_paths[j], terminals[i]);
 			// Check if the terminal executable exists
 			if (access(terminal_path, X_OK) != -1) {
-				// Open the terminal using run_cmd
-				run_cmd(terminals[i]);
-				return; // Exit the function once the terminal is opened
+				// Open the terminal together with the other startup commands
+				autostart_add(server->autostart, cmdcache_add(server->commands, terminal_path));
+				return; // Exit the function once the terminal is found
 			}
 		}
 	}
@@ -3344,73 +4639,34 @@ static void startup_terminal(void) {
 }
 
 /* Processing startup commands */
-// Function to trim spaces and other whitespace characters from the start and end of a string
-static char *trim(char *str) {
-	char *start = str;
-	char *end = str + strlen(str) - 1;
-	// Trim leading whitespace characters
-	while (isspace((unsigned char)*start)) {
-		start++;
-	}
-	// Trim trailing whitespace characters
-	while (end > start && isspace((unsigned char)*end)) {
-		*end-- = '\0';
-	}
-	return start;
-}
-
-// Function to process startup commands from the configuration file
-static int process_startup_commands(void *data) {
-	struct woodland_server *server = data;
-	char *config = server->config;
-	char command[MAX_NR_OF_STARTUP_COMMANDS][1024];
+// Queues the startup commands from the configuration file for autostart
+static void process_startup_commands(struct woodland_server *server) {
 	int num_commands = 0;
 
-	FILE *file = fopen(config, "r");
-	if (file == NULL) {
-		perror("Error opening file");
-		return 1;
-	}
-
-	char line[1024];
-	while (fgets(line, sizeof(line), file) != NULL) {
-		// Ignore comments and empty lines
-		if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+	const struct config_entry *entry = config_store_first(server->conf, "startup_command");
+	for (; entry; entry = config_store_next(server->conf, entry)) {
+		if (entry->value[0] == '\0') {
 			continue;
 		}
-
-		// Check for lines starting with 'startup_command'
-		if (strstr(line, "startup_command") != NULL) {
-			// Split by '='
-			char *token = strtok(line, "=");
-			token = strtok(NULL, "=");
-			if (token != NULL) {
-				// Trim leading and trailing spaces from the command
-				char *trimmed_command = trim(token);
-				if (strlen(trimmed_command) > 0) {
-					strcpy(command[num_commands], trimmed_command);
-					num_commands++;
-					if (num_commands >= MAX_NR_OF_STARTUP_COMMANDS) {
-						break; // Avoid overflow
-					}
-				}
-			}
-		}
+		autostart_add(server->autostart, cmdcache_add(server->commands, entry->value));
+		num_commands++;
 	}
-	fclose(file);
 	if (num_commands == 0) {
 		// If no commands are specified, launch the default terminal
 		wlr_log(WLR_INFO, "No startup commands specified. Launching default terminal.");
-		startup_terminal();
-	}
-	else {
-		// Execute each command from the array
-		for (int i = 0; i < num_commands; ++i) {
-			wlr_log(WLR_INFO, "Launching command: %s", command[i]);
-			run_cmd(command[i]);
-		}
+		startup_terminal(server);
 	}
-	wl_event_source_remove(server->autostart_timer);
+}
+
+static int handle_terminate_signal(int signal, void *data) {
+	(void)signal;
+	wl_display_terminate(data);
+	return 0;
+}
+
+static int handle_dump_signal(int signal, void *data) {
+	(void)signal;
+	latency_dump(data);
 	return 0;
 }
 
@@ -3451,19 +4707,42 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 	snprintf(server.config, strlen(HOME) + strlen(configPath) + 3, "%s%s", HOME, configPath);
-	server.play_pause = get_char_value_from_conf(server.config, "play_pause");
-	server.volume_up = get_char_value_from_conf(server.config, "volume_up");
-	server.volume_down = get_char_value_from_conf(server.config, "volume_down");
-	server.volume_mute = get_char_value_from_conf(server.config, "volume_mute");
-	server.brightness_path = get_char_value_from_conf(server.config, "d_power_path");
+	// Parse woodland.ini once, every setting below is read from memory
+	server.conf = config_store_load(server.config);
+	if (!server.conf) {
+		wlr_log(WLR_ERROR, "Failed to load config: %s\n", server.config);
+		return 1;
+	}
+	server.brightness_path = config_store_get_string(server.conf, "d_power_path", NULL);
 
 	/* Getting zoom variables */
 	server.pan_offset_x = 0;
 	server.pan_offset_y = 0;
 	server.zoom_factor = 1.0;
-	server.zoom_speed = get_double_value_from_conf(server.config, "zoom_speed");
-	server.zoom_top_edge = get_char_value_from_conf(server.config, "zoom_top_edge");
-	server.zoom_edge_threshold = get_double_value_from_conf(server.config, "zoom_edge_threshold");
+	server.zoom_speed = config_store_get_double(server.conf, "zoom_speed", 5);
+	server.zoom_top_edge = config_store_get_string(server.conf, "zoom_top_edge", "disabled");
+	server.zoom_edge_threshold = config_store_get_double(server.conf, "zoom_edge_threshold", 30);
+	server.zoom_filter_nearest = strcmp(config_store_get_string(server.conf, "zoom_filter",
+																"linear"), "nearest") == 0;
+
+
+	/* Compile the keymap once, each layout of xkb_layouts becomes a group */
+	server.xkb_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+	if (!server.xkb_context) {
+		wlr_log(WLR_ERROR, "Failed to create XKB context!");
+		return 1;
+	}
+	struct xkb_rule_names rules = {
+		.layout = config_store_get_string(server.conf, "xkb_layouts", "us"),
+		.options = "grp:alt_shift_toggle" // Option to switch layout with Alt+Shift
+	};
+	server.keymap = xkb_keymap_new_from_names(server.xkb_context, &rules,
+														XKB_KEYMAP_COMPILE_NO_FLAGS);
+	if (!server.keymap) {
+		wlr_log(WLR_ERROR, "Failed to create XKB keymap!");
+		return 1;
+	}
+	server.LayoutIndexes = xkb_keymap_num_layouts(server.keymap);
 
 	/* Idle variable */
 	server.idle_enabled = false;
@@ -3520,23 +4799,123 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
-	/*** Timer to set background image
-	 * I didn't have much time to fiddle around with serial error:
-	 * xdg_wm_base@8: error 4: wrong configure serial
-	 * so I just added this timer as a workaround, it sets the background after
-	 * a few seconds and thus it avoids the wrong serial error.
-	 */
 	struct wl_event_loop *event_loop = wl_display_get_event_loop(server.wl_display);
 	if (!event_loop) {
 		wlr_log(WLR_ERROR, "Failed to get event loop from Wayland display!");
 		return 1;
 	}
-	server.timer = wl_event_loop_add_timer(event_loop, set_background_image_func, &server);
-	if (!server.timer) {
-		wlr_log(WLR_ERROR, "Failed to create timer!");
+
+	/* SIGTERM and SIGINT end the event loop, so the shutdown below runs and
+	 * logs the statistics */
+	struct wl_event_source *sigterm_source = wl_event_loop_add_signal(event_loop, SIGTERM,
+														handle_terminate_signal, server.wl_display);
+	struct wl_event_source *sigint_source = wl_event_loop_add_signal(event_loop, SIGINT,
+														handle_terminate_signal, server.wl_display);
+
+	/* Input latency is traced from the start, SIGUSR1 logs it while running */
+	server.latency = latency_tracker_create();
+	if (!server.latency) {
+		wlr_log(WLR_ERROR, "Failed to create latency tracker!");
+		return 1;
+	}
+	struct wl_event_source *sigusr1_source = wl_event_loop_add_signal(event_loop, SIGUSR1,
+														handle_dump_signal, server.latency);
+
+	/* Commands are spawned from here, children are reaped by the event loop */
+	server.launcher = launcher_create(event_loop);
+	if (!server.launcher) {
+		wlr_log(WLR_ERROR, "Failed to create launcher!");
+		return 1;
+	}
+
+	/* Every configured command is split and resolved in $PATH once */
+	server.commands = cmdcache_create(event_loop);
+	if (!server.commands) {
+		wlr_log(WLR_ERROR, "Failed to create command cache!");
+		return 1;
+	}
+	server.play_pause = cmdcache_add(server.commands,
+							config_store_get_string(server.conf, "play_pause", NULL));
+	server.volume_up = cmdcache_add(server.commands,
+							config_store_get_string(server.conf, "volume_up", NULL));
+	server.volume_down = cmdcache_add(server.commands,
+							config_store_get_string(server.conf, "volume_down", NULL));
+	server.volume_mute = cmdcache_add(server.commands,
+							config_store_get_string(server.conf, "volume_mute", NULL));
+
+	/* Startup commands, -s replaces the ones from woodland.ini */
+	server.autostart = autostart_create(event_loop, server.launcher,
+						config_store_get_string(server.conf, "startup_order", NULL),
+						config_store_get_int(server.conf, "startup_order_timeout", 3000));
+	if (!server.autostart) {
+		wlr_log(WLR_ERROR, "Failed to create autostart!");
+		return 1;
+	}
+	if (startup_cmd) {
+		autostart_add(server.autostart, cmdcache_add(server.commands, startup_cmd));
+	}
+	else {
+		process_startup_commands(&server);
+	}
+
+	/* Keyboard shortcuts are compiled once into a lookup table */
+	server.keybindings = keybindings_create(server.conf, server.commands);
+	if (!server.keybindings) {
+		wlr_log(WLR_ERROR, "Failed to create keybindings table!");
+		return 1;
+	}
+	/*** The background image is decoded on a worker thread, the texture is
+	 * created on the event loop as soon as the pixels are ready. */
+	server.bgloader = bgloader_create(event_loop);
+	if (!server.bgloader) {
+		wlr_log(WLR_ERROR, "Failed to create background loader!");
+		return 1;
+	}
+	/*** Hidden and minimized views get their frame callbacks from a slow timer. */
+	server.frame_throttle_timer = wl_event_loop_add_timer(event_loop, frame_throttle_tick, &server);
+	if (!server.frame_throttle_timer) {
+		wlr_log(WLR_ERROR, "Failed to create frame throttle timer!");
 		return 1;
 	}
-	wl_event_source_timer_update(server.timer, 3000);
+	/* Outputs ask for the background at their own resolution, the decoding
+	 * starts now so the image is ready by then. */
+	server.background_path = config_store_get_string(server.conf, "background", NULL);
+	const char *background_mode = config_store_get_string(server.conf, "background_mode", "fill");
+	if (!imagescale_mode_from_name(background_mode, &server.background_mode)) {
+		wlr_log(WLR_ERROR, "Unknown background_mode '%s', using 'fill'", background_mode);
+		server.background_mode = IMAGESCALE_FILL;
+	}
+	/* The scaler writes the byte order the renderer uploads as is, ARGB8888
+	 * if it has it (EXT_texture_format_BGRA8888 on GLES2). */
+	server.background_format = DRM_FORMAT_ABGR8888;
+	size_t num_formats;
+	const uint32_t *formats = wlr_renderer_get_shm_texture_formats(server.renderer, &num_formats);
+	for (size_t i = 0; i < num_formats; i++) {
+		if (formats[i] == DRM_FORMAT_ARGB8888) {
+			server.background_format = DRM_FORMAT_ARGB8888;
+			break;
+		}
+	}
+	/*** Without a GPU the pixman renderer composites on the CPU, the tiles of
+	 * every frame are spread over a pool of threads. */
+	if (wlr_renderer_is_pixman(server.renderer)) {
+		int threads = config_store_get_int(server.conf, "cpu_render_threads", 0);
+		if (threads <= 0) {
+			threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		}
+		if (threads > 1) {
+			server.tilepool = tilepool_create(threads);
+			if (server.tilepool) {
+				wlr_log(WLR_INFO, "CPU compositing on %d threads", server.tilepool->num_threads + 1);
+			}
+		}
+	}
+	if (server.background_path) {
+		bgloader_prefetch(server.bgloader, server.background_path);
+	}
+	else {
+		wlr_log(WLR_INFO, "No background image provided.");
+	}
 
 	/*** Autocreates an allocator for us.
 	 * The allocator is the bridge between the renderer and the backend. It
@@ -3559,6 +4938,9 @@ int main(int argc, char *argv[]) {
 		wlr_log(WLR_ERROR, "Failed to create compositor!");
 		return 1;
 	}
+	// Every surface commit is turned into output damage
+	server.new_surface.notify = server_new_surface;
+	wl_signal_add(&server.compositor->events.new_surface, &server.new_surface);
 
 	/*** Creates an output layout, which a wlroots utility for working with an
 	 * arrangement of screens in a physical layout. */
@@ -3567,6 +4949,9 @@ int main(int argc, char *argv[]) {
 		wlr_log(WLR_ERROR, "Failed to create output layout!");
 		return 1;
 	}
+	// Views follow the outputs they intersect as the layout changes
+	server.output_layout_change.notify = output_layout_change;
+	wl_signal_add(&server.output_layout->events.change, &server.output_layout_change);
 	/*** Configure a listener to be notified when new outputs are available on the backend. */
 	wl_list_init(&server.outputs);
 	server.new_output.notify = server_new_output;
@@ -3595,6 +4980,12 @@ int main(int argc, char *argv[]) {
 	 */
 	/*** Initialize list for keyboards. */
 	wl_list_init(&server.keyboards);
+	wl_list_init(&server.virtual_keyboards);
+	server.group_keyboard = server_new_keyboard_group(&server);
+	if (!server.group_keyboard) {
+		wlr_log(WLR_ERROR, "Failed to create keyboard group!");
+		return 1;
+	}
 
 	/*** Configure a listener to be notified when new input devices are available
 	 & on the backend.
@@ -3618,7 +5009,7 @@ int main(int argc, char *argv[]) {
 
 	/*** Idle timer */
 	// Get timeout from confing file
-	int idle_timeout = get_int_value_from_conf(server.config, "idle_timeout");
+	int idle_timeout = config_store_get_int(server.conf, "idle_timeout", 0);
 	// idle_timeout = 0 disabled the idle manager
 	if (idle_timeout != 0) {
 		/*** Initialize idle management features. */
@@ -3697,13 +5088,14 @@ int main(int argc, char *argv[]) {
 		wlr_log(WLR_ERROR, "Failed to create XCursor manager.");
 		return 1;
 	}
-	wlr_xcursor_manager_load(server.cursor_mgr, 1);
-	if (!server.cursor_mgr) {
+	// Outputs with another scale load it as they come
+	cursor_load_scale(&server, 1);
+	if (server.num_cursor_scales == 0) {
 		wlr_log(WLR_ERROR, "Failed to load XCursor manager.");
 		return 1;
 	}
 	// Set the initial cursor image
-	wlr_xcursor_manager_set_cursor_image(server.cursor_mgr, "left_ptr", server.cursor);
+	cursor_set_image(&server, "left_ptr");
 
 	/*
 	 * wlr_cursor *only* displays an image on screen. It does not move around
@@ -3761,6 +5153,15 @@ int main(int argc, char *argv[]) {
 	server.new_virtual_keyboard.notify = new_virtual_keyboard_handler;
 	wl_signal_add(&server.virtual_keyboard_mgr->events.new_virtual_keyboard,
 											  &server.new_virtual_keyboard);
+	/*** Virtual pointers are handled like any other pointer. */
+	server.virtual_pointer_mgr = wlr_virtual_pointer_manager_v1_create(server.wl_display);
+	if (!server.virtual_pointer_mgr) {
+		wlr_log(WLR_ERROR, "Failed to create virtual pointer manager!");
+		return 1;
+	}
+	server.new_virtual_pointer.notify = new_virtual_pointer_handler;
+	wl_signal_add(&server.virtual_pointer_mgr->events.new_virtual_pointer,
+											  &server.new_virtual_pointer);
 
 	/*** Initialize data-related interfaces. */
 	if (!wlr_viewporter_create(server.wl_display)) {
@@ -3811,18 +5212,8 @@ int main(int argc, char *argv[]) {
 		wl_display_destroy(server.wl_display);
 		return 1;
 	}
-	if (startup_cmd) {
-		if (fork() == 0) {
-			run_cmd(startup_cmd);
-		}
-	}
-	else {
-		/*** Startup commands after delay */
-		server.autostart_timer = wl_event_loop_add_timer(event_loop,
-														 process_startup_commands,
-														 &server);
-		wl_event_source_timer_update(server.autostart_timer, 7000);
-	}
+	/*** Startup commands go as soon as an output is in the layout as well */
+	autostart_backend_ready(server.autostart);
 	/* Run the Wayland event loop. This does not return until you exit the
 	 * compositor. Starting the backend rigged up all of the necessary event
 	 * loop configuration to listen to libinput events, DRM events, generate
@@ -3832,32 +5223,60 @@ int main(int argc, char *argv[]) {
 
 	/* Once wl_display_run returns, we shut down the server. */
 	wlr_log(WLR_INFO, "Shutting down Woodland compositor...");
-
-	// Clean up signals (assuming signal cleanup functions are available)
-	// Free allocated memory
-	if (server.zoom_top_edge) {
-		free(server.zoom_top_edge);
-		server.zoom_top_edge = NULL;
-	}
-	if (server.brightness_path) {
-		free(server.brightness_path);
-		server.brightness_path = NULL;
-	}
-	if (server.play_pause) {
-		free(server.play_pause);
-		server.play_pause = NULL;
-	}
-	if (server.volume_up) {
-		free(server.volume_up);
-		server.volume_up = NULL;
-	}
-	if (server.volume_down) {
-		free(server.volume_down);
-		server.volume_down = NULL;
-	}
-	if (server.volume_mute) {
-		free(server.volume_mute);
-		server.volume_mute = NULL;
+	char timing[160];
+	histogram_format(&server.key_time, timing, sizeof(timing));
+	wlr_log(WLR_INFO, "Timing keyboard_handle_key: %s", timing);
+	histogram_format(&server.motion_time, timing, sizeof(timing));
+	wlr_log(WLR_INFO, "Timing process_cursor_motion: %s, %lu motion events coalesced",
+											timing, server.motions_coalesced);
+	wlr_log(WLR_INFO, "Interactive resize: %lu configures, %lu sizes coalesced",
+											server.resize_configures, server.resizes_coalesced);
+	wlr_log(WLR_INFO, "Cursor: %lu images set, %lu requests for the image shown",
+											server.cursor_image_sets, server.cursor_images_kept);
+	latency_dump(server.latency);
+
+	// Clean up signals
+	if (sigterm_source) {
+		wl_event_source_remove(sigterm_source);
+	}
+	if (sigint_source) {
+		wl_event_source_remove(sigint_source);
+	}
+	if (sigusr1_source) {
+		wl_event_source_remove(sigusr1_source);
+	}
+	// Free allocated memory, the config values are owned by the config store
+	if (server.keybindings) {
+		keybindings_destroy(server.keybindings);
+		server.keybindings = NULL;
+	}
+	if (server.bgloader) {
+		bgloader_destroy(server.bgloader);
+		server.bgloader = NULL;
+	}
+	if (server.tilepool) {
+		tilepool_destroy(server.tilepool);
+		server.tilepool = NULL;
+	}
+	if (server.frame_throttle_timer) {
+		wl_event_source_remove(server.frame_throttle_timer);
+		server.frame_throttle_timer = NULL;
+	}
+	if (server.autostart) {
+		autostart_destroy(server.autostart);
+		server.autostart = NULL;
+	}
+	if (server.launcher) {
+		launcher_destroy(server.launcher);
+		server.launcher = NULL;
+	}
+	if (server.commands) {
+		cmdcache_destroy(server.commands);
+		server.commands = NULL;
+	}
+	if (server.conf) {
+		config_store_destroy(server.conf);
+		server.conf = NULL;
 	}
 	if (server.config) {
 		free(server.config);
@@ -3889,7 +5308,14 @@ int main(int argc, char *argv[]) {
 		wlr_backend_destroy(server.backend);
 		server.backend = NULL;
 	}
+	if (server.keyboard_group) {
+		// Also frees group_keyboard through its destroy listener
+		wlr_keyboard_group_destroy(server.keyboard_group);
+		server.keyboard_group = NULL;
+		server.group_keyboard = NULL;
+	}
 	if (server.output_layout) {
+		wl_list_remove(&server.output_layout_change.link);
 		wlr_output_layout_destroy(server.output_layout);
 		server.output_layout = NULL;
 	}
@@ -3903,6 +5329,17 @@ int main(int argc, char *argv[]) {
 		wl_display_destroy(server.wl_display);
 		server.wl_display = NULL;
 	}
+	if (server.keymap) {
+		xkb_keymap_unref(server.keymap);
+		server.keymap = NULL;
+	}
+	if (server.xkb_context) {
+		xkb_context_unref(server.xkb_context);
+		server.xkb_context = NULL;
+	}
+	// Outputs and surfaces drop their samples until the display is gone
+	latency_tracker_destroy(server.latency);
+	server.latency = NULL;
 	wlr_log(WLR_INFO, "See you next time in Woodland :)");
 
 	return 0;